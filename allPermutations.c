@@ -11,9 +11,14 @@
 
 
 /* How to compile and use code:
-    1. gcc -c allPermutations.c -o allPermutations.o
-    2. gcc source.o allPermutations.o -o program -L../cJSON -lcjson
-    3. ./program
+    1. make allPermutations (links libplanner.a for the plan loading and
+       helpers)
+    2. ./allPermutations [lin | walk]
+
+    every order of the attractions is scored by its own total time, or with
+    "lin" by the total time a lin() search started from it ends at, and the
+    times are printed as a histogram. "walk" scores every order by its
+    walking minutes only, enumerated by adjacent swaps (plain_changes)
 */
 
 /* struct that holds the total time for each permutation (number) and the count 
@@ -63,6 +68,11 @@ int factorial(int n) {
     return n * factorial(n - 1);
 }
 
+// function used for quicksort 
+int cmpfunc (const void * a, const void * b) {
+   return ( *(int*)a - *(int*)b );
+}
+
 // used to insert a new key into the hash table 
 void insert(struct HashTable* hashTable, int key) {
     
@@ -133,24 +143,22 @@ struct HashTable* createHashTable(int size) {
     return hashTable;
 }
 
-// Lin-Kernighan Algorithm 
-int lin(int* attractionLabels, int rows, int* key, int startTime, unsigned long** adjustedMatrix, int waitMatrix[MAX_ROWS][MAX_COLS], int *rideMatrixArray){
-    
-    // copying attraction array to a new array 
-    int *orig = (int*)malloc(rows * sizeof(int));
-        for (int i = 0; i < rows; i++) {
-            orig[i] = attractionLabels[i];
-        }
+/* Lin-Kernighan Algorithm, started from a copy of the given tour of rows.
+   Most starting orders end in one of a few local optima, so the schedule
+   of each best tour is kept in the tour cache and scored once */
+int lin(const struct Plan *plan, const int *tour, struct TourCache *cache) {
+    int rows = plan->length;
 
-    int original_cost = getCost(adjustedMatrix, attractionLabels, rows);
+    // copying the tour so the permutation being enumerated isn't changed
+    int original_tour[MAX_ROWS], best_tour[MAX_ROWS];
+    memcpy(original_tour, tour, rows * sizeof(int));
+    memcpy(best_tour, tour, rows * sizeof(int));
+
+    int original_cost = walkingCost(plan, original_tour, rows);
 
-    int *original_tour = attractionLabels;
     int best_cost = original_cost;
-    int *best_tour = original_tour;
     int max_loops = 1000;
-    int new_tour[MAX_TOUR], new_cost;
-
-    srand(time(NULL));
+    int new_tour[MAX_ROWS], new_cost;
 
     // algorithm implementation
     while (max_loops-- > 0) {
@@ -160,8 +168,8 @@ int lin(int* attractionLabels, int rows, int* key, int startTime, unsigned long*
             p2 = (rand() % (rows - 2)) + 1;
         }
 
-        flip(original_tour, new_tour, p1, p2, rows);
-        new_cost = getCost(adjustedMatrix, new_tour, rows);
+        flipTour(plan, original_tour, new_tour, p1, p2);
+        new_cost = walkingCost(plan, new_tour, rows);
 
         int gain = original_cost - new_cost; 
 
@@ -178,28 +186,70 @@ int lin(int* attractionLabels, int rows, int* key, int startTime, unsigned long*
         }
     }
 
-    // finds the original index of each attraction 
-    int newIndices[rows];
-    generateNewIndices(best_tour, rows, key, newIndices);
-
-    /* the loop to figure out the arrival time, mount time, and dismount time
-        for each attraction */
-    int off_time = startTime;
-    for (int i = 1; i < rows - 1; i++) {
-        int arrival_time = off_time + (int)adjustedMatrix[best_tour[i - 1]][best_tour[i]];
-        int mount_time = arrival_time + calculateWait(waitMatrix, newIndices[i], calculateSegments(startTime, arrival_time, 15));
-        off_time = mount_time + rideMatrixArray[newIndices[i]];
+    // arrival, mount and dismount times of the best tour, back at the entrance
+    unsigned long long hash = hashTour(cache, best_tour);
+    struct CacheEntry *entry = findTour(cache, hash);
+    if (entry == NULL) {
+        entry = storeTour(cache, hash, scheduleTour(plan, best_tour, NULL, NULL));
     }
+    return entry->cost;
 
-    // calculate the time it takes to walk back to 37 (the entrance)
-    int end_time = off_time + (int)adjustedMatrix[best_tour[rows - 2]][best_tour[rows - 1]];
+}
 
-    return end_time - startTime;
+/* walking minutes and timeline of a permutation from position "from" on.
+   walked[i] and offTimes[i] are the walking so far and the time the guest
+   gets off stop i, so everything before "from" is reused as it is. Returns
+   the total time */
+int evaluateFrom(const struct Plan *plan, const int *arr, int *walked, int *offTimes, int from) {
+    int n = plan->length;
+    for (int i = from; i < n; i++) {
+        walked[i] = walked[i - 1] + plan->walk[arr[i - 1] * n + arr[i]];
+    }
+    return rescheduleFrom(plan, arr, NULL, offTimes, from);
+}
 
+/* keeps the order in best if it is one of the shortest days so far. When
+   only canonical orders are scored its reverse takes as long, so that is
+   offered too */
+void offerOrder(const struct Plan *plan, const int *arr, int time, bool canonical, struct BestTours *best) {
+    int length = plan->length;
+    if (time > bestToursLimit(best)) {
+        return;
+    }
+    offerBestTour(best, arr, length, time);
+    if (canonical) {
+        int reversed[MAX_ROWS];
+        reversed[0] = arr[0];
+        reversed[length - 1] = arr[length - 1];
+        for (int i = 1; i < length - 1; i++) {
+            reversed[i] = arr[length - 1 - i];
+        }
+        offerBestTour(best, reversed, length, time);
+    }
 }
 
-// function that finds all possible permutations of the list
-struct StorageResult brheap_nonrecur(int* arr, int length, int* key, int startTime, unsigned long** adjustedMatrix, int waitMatrix[MAX_ROWS][MAX_COLS], int *rideMatrixArray) {
+/* function that finds all possible permutations of the list of rows. Each
+   permutation gets its total time, from a full lin() search started at it
+   when useLin is set, otherwise from its own timeline. Heap's algorithm
+   only changes positions s + 1 and later on each step, so the timeline is
+   kept as a stack of prefix states and rescheduled from s + 1 only, which
+   on average is the last two or three stops. When neither the walks nor
+   the waits depend on direction (symmetricWalk and flatWaits) a tour takes
+   as long as its reverse, so only orders whose first attraction has a lower
+   row than the last are scored, each stored twice. With time-dependent
+   waits every order is scored */
+struct StorageResult brheap_nonrecur(const struct Plan *plan, int* arr, struct TourCache *cache, bool useLin) {
+    int length = plan->length;
+
+    // prefix states: walking minutes and off time after each stop
+    int walked[MAX_ROWS], offTimes[MAX_ROWS];
+    int best_time, best_walk, best_tour[MAX_ROWS];
+    struct BestTours best;
+    initBestTours(&best, MAX_BEST);
+    bool canonical = !useLin && plan->symmetricWalk && plan->flatWaits;
+    int stale = length;     // first prefix state not rescheduled for the current order
+    walked[0] = 0;
+    offTimes[0] = plan->startTime;
 
     // finds number of permutations for the length of the array (without the first and last element)
     int numPermutations = factorial(length - 2); 
@@ -219,16 +269,29 @@ struct StorageResult brheap_nonrecur(int* arr, int length, int* key, int startTi
     }  
     s = length - 4; 
 
+    int labels[MAX_ROWS];
+    tourToLabels(plan, arr, labels);
     printf("\nAttractions: ");
-    printArray(arr, length);
+    printArray(labels, length);
     printf("\n");
 
     // calculate and store the total time for the initial arrangement (without the first and last elements)
-    storage[count] = lin(arr, length, key, startTime, adjustedMatrix, waitMatrix, rideMatrixArray);
+    storage[count] = useLin ? lin(plan, arr, cache) : evaluateFrom(plan, arr, walked, offTimes, 1);
+    best_time = storage[count];
+    best_walk = walked[length - 1];
+    memcpy(best_tour, arr, length * sizeof(int));
+    if (!useLin) {
+        offerOrder(plan, arr, storage[count], canonical, &best);
+    }
     // printf("Index: %d, Time: %d\n", count, storage[count]);
     count++;
 
     int index = 1;
+    if (canonical) {
+        // the reverse of a first order that isn't canonical is stored later
+        storage[1] = storage[0];
+        index = arr[1] > arr[length - 2] ? 0 : 2;
+    }
     while (s >= 0) {
 
         // swaps within the valid range  
@@ -249,10 +312,29 @@ struct StorageResult brheap_nonrecur(int* arr, int length, int* key, int startTi
                 // ^ repeat this until i is less than n
             }
 
-            // Calculate and store the total time for the new arrangement (without the first and last elements)
-            storage[index] = lin(arr, length, key, startTime, adjustedMatrix, waitMatrix, rideMatrixArray);
-            // printf("Index: %d, Time: %d\n", index, storage[index]);
-            index++;
+            if (canonical && arr[1] > arr[length - 2]) {
+                // its reverse is (or was) scored and stored twice
+                stale = stale < s + 1 ? stale : s + 1;
+            } else {
+                // Calculate and store the total time for the new arrangement (without the first and last elements)
+                int from = stale < s + 1 ? stale : s + 1;
+                storage[index] = useLin ? lin(plan, arr, cache) : evaluateFrom(plan, arr, walked, offTimes, from);
+                stale = length;
+                if (!useLin) {
+                    offerOrder(plan, arr, storage[index], canonical, &best);
+                }
+                if (!useLin && storage[index] < best_time) {
+                    best_time = storage[index];
+                    best_walk = walked[length - 1];
+                    memcpy(best_tour, arr, length * sizeof(int));
+                }
+                // printf("Index: %d, Time: %d\n", index, storage[index]);
+                index++;
+                if (canonical) {
+                    storage[index] = storage[index - 1];
+                    index++;
+                }
+            }
 
             // Increment count
             count++;
@@ -271,6 +353,25 @@ struct StorageResult brheap_nonrecur(int* arr, int length, int* key, int startTi
     // print number of permutations 
     printf("\nPermutations: %d\n\n", count);
 
+    if (!useLin) {
+        tourToLabels(plan, best_tour, labels);
+        printf("Shortest day: %d minutes with %d minutes walking\nOrder: ", best_time, best_walk);
+        printArray(labels, length);
+        printf("\n\n");
+
+        sortBestTours(plan, &best, NULL);
+        printf("%d shortest days (minutes, back at the entrance, order):\n", best.size);
+        for (int i = 0; i < best.size; i++) {
+            tourToLabels(plan, best.tours[i], labels);
+            char* finishStr = clockTime(best.offTimes[i][length - 1]);
+            printf("%5d  %s  ", best.cost[i], finishStr);
+            free(finishStr);
+            printArray(labels, length);
+            printf("\n");
+        }
+        printf("\n");
+    }
+
 
     // packages the array of times and the number of permutations, so we can use both later
     struct StorageResult result;
@@ -281,6 +382,133 @@ struct StorageResult brheap_nonrecur(int* arr, int length, int* key, int startTi
 }
 
 
+/* walking minutes of every order of arr[first..last] in "plain changes"
+   order (Steinhaus-Johnson-Trotter, Knuth's Algorithm P), where each order
+   is the last with two neighbouring attractions swapped. Swapping arr[i]
+   and arr[i + 1] only changes the three walks between arr[i - 1] and
+   arr[i + 2], so the running total "cost" is updated from those and the
+   tour is never summed again. Each total is stored "copies" times, and the
+   least walking order is kept in best_tour. c[j] and o[j] are the position
+   and direction of attraction j in the algorithm's inversion table */
+void walk_changes(const struct Plan *plan, int* arr, int first, int last, int cost, int copies, int* storage, int* count, int* best_walk, int* best_tour) {
+    int length = plan->length;
+    int m = last - first + 1;
+    const int *walk = plan->walk;
+
+    int c[MAX_ROWS], o[MAX_ROWS];
+    for (int j = 1; j <= m; j++) {
+        c[j] = 0;
+        o[j] = 1;
+    }
+
+    bool done = false;
+    while (!done) {
+        for (int k = 0; k < copies; k++) {
+            storage[(*count)++] = cost;
+        }
+        if (cost < *best_walk) {
+            *best_walk = cost;
+            memcpy(best_tour, arr, length * sizeof(int));
+        }
+
+        // finds the attraction j that moves next, s counts the ones done at an end
+        int j = m, s = 0, q = 0;
+        while (!done) {
+            if (j < 1) {
+                done = true;
+                break;
+            }
+            q = c[j] + o[j];
+            if (q == j) {
+                if (j == 1) {
+                    done = true;
+                    break;
+                }
+                s++;
+            } else if (q >= 0) {
+                break;
+            }
+            o[j] = -o[j];
+            j--;
+        }
+        if (done) {
+            break;
+        }
+
+        // arr[first..last] is the algorithm's a[1..m], the two positions are neighbours
+        int a = j - c[j] + s;
+        int b = j - q + s;
+        int i = first - 1 + (a < b ? a : b);
+        int p = arr[i - 1], x = arr[i], y = arr[i + 1], r = arr[i + 2];
+        cost += walk[p * length + y] + walk[y * length + x] + walk[x * length + r]
+              - walk[p * length + x] - walk[x * length + y] - walk[y * length + r];
+        arr[i] = y;
+        arr[i + 1] = x;
+        c[j] = q;
+    }
+}
+
+/* function that finds the walking minutes of every permutation of the
+   attractions, by walk_changes(). When the plan walks every tour as far as
+   its reverse (symmetricWalk) only the orders whose first attraction has a
+   lower row than the last are walked: each pair of end attractions is
+   placed in turn and the ones between are enumerated, and every total is
+   stored twice so the histogram still counts every permutation */
+struct StorageResult plain_changes(const struct Plan *plan, int* arr) {
+    int length = plan->length;
+    int m = length - 2;
+
+    int numPermutations = factorial(m);
+    int* storage = (int*)malloc(numPermutations * sizeof(int));
+    int count = 0;
+
+    int labels[MAX_ROWS];
+    tourToLabels(plan, arr, labels);
+    printf("\nAttractions: ");
+    printArray(labels, length);
+    printf("\n");
+
+    int best_walk = walkingCost(plan, arr, length), best_tour[MAX_ROWS];
+    memcpy(best_tour, arr, length * sizeof(int));
+
+    if (plan->symmetricWalk && m >= 2) {
+        // the attractions in row order, so an order is canonical if arr[1] < arr[m]
+        int rows[MAX_ROWS];
+        memcpy(rows, arr + 1, m * sizeof(int));
+        qsort(rows, m, sizeof(int), cmpfunc);
+
+        for (int lo = 0; lo < m; lo++) {
+            for (int hi = lo + 1; hi < m; hi++) {
+                int index = 2;
+                arr[1] = rows[lo];
+                arr[m] = rows[hi];
+                for (int k = 0; k < m; k++) {
+                    if (k != lo && k != hi) {
+                        arr[index++] = rows[k];
+                    }
+                }
+                walk_changes(plan, arr, 2, m - 1, walkingCost(plan, arr, length), 2, storage, &count, &best_walk, best_tour);
+            }
+        }
+        printf("\nReversed orders skipped, the walk matrix is symmetric\n");
+    } else {
+        walk_changes(plan, arr, 1, m, walkingCost(plan, arr, length), 1, storage, &count, &best_walk, best_tour);
+    }
+
+    printf("\nPermutations: %d\n\n", count);
+
+    tourToLabels(plan, best_tour, labels);
+    printf("Least walking: %d minutes\nOrder: ", best_walk);
+    printArray(labels, length);
+    printf("\n\n");
+
+    struct StorageResult result;
+    result.storageArray = storage;
+    result.count = count;
+
+    return result;
+}
+
 // finds the max element in the array 
 int max(int arr[], int length) {
     int largest = arr[0]; 
@@ -307,185 +535,47 @@ int min(int arr[], int length) {
     return smallest;
 }
 
-// function used for quicksort 
-int cmpfunc (const void * a, const void * b) {
-   return ( *(int*)a - *(int*)b );
-}
 
-int main() {
-    int arr[] = {37,103,104,20,15,95,111,22,7,113,112,37};
-    int length = sizeof(arr) / sizeof(arr[0]);
+int main(int argc, char *argv[]) {
+    bool useLin = argc > 1 && strcmp(argv[1], "lin") == 0;
+    bool useWalk = argc > 1 && strcmp(argv[1], "walk") == 0;
 
     // reads json file so we can use it 
-    char *filename = "useCase.json";
-	FILE *fp = fopen("useCase.json", "r");
-	if (fp == NULL) {
-		printf("Error: Unable to open the file.\n");
-		return 1;
-	}
-
-	char buffer[getSize(filename)];
-	fread(buffer, 1, sizeof(buffer), fp);
-	fclose(fp);
-
-	cJSON *json = cJSON_Parse(buffer);
-	if (json == NULL) {
-		const char *error_ptr = cJSON_GetErrorPtr();
-		if (error_ptr != NULL) {
-			printf("Error: %s\n", error_ptr);
-		}
-		cJSON_Delete(json);
-		return 1;
-	}
-
-/*............................................................................*/
-
-	// defining variables we will use 
-
-	// reading in pointers to lists we need 
-	cJSON *attractions = cJSON_GetObjectItemCaseSensitive(json, "Evaluate535Only");
-	cJSON *rideMatrix = cJSON_GetObjectItem(json, "RideMatrix");
-
-	// rows can be used to represent length 
-	int rows = cJSON_GetArraySize(attractions);
-	int cols = cJSON_GetArraySize(attractions);
-	
-	// saving the location of matrices to later make them into a 2D array 
-	cJSON *distanceData = cJSON_GetObjectItem(json, "DistanceMatrix");
-	cJSON *waitData = cJSON_GetObjectItem(json, "WaitMatrix");
-
-	// reading in vars
-	cJSON *start = cJSON_GetObjectItemCaseSensitive(json, "Start");
-	int startTime = cJSON_GetNumberValue(start);
-	cJSON *sliceLength = cJSON_GetObjectItemCaseSensitive(json, "TimesliceLength");
-	int segment = cJSON_GetNumberValue(sliceLength);
-
-
-	cJSON *attractionKey = cJSON_GetObjectItemCaseSensitive(json, "AttractionsToInclude");
-	int *key = malloc(rows * sizeof(int));
-	cJSON *l;
-	int j = 0;
-	cJSON_ArrayForEach(l, attractionKey) {
-		*(key + j) = atoi(strtok(l-> valuestring, "HS"));
-		j++;
-	}
-        
-/*............................................................................*/
-
-
-	// copying the data from the distance matrix into a C array 
-	int row_idx = 0;
-	cJSON *rowArray, *cellValue;
-	int distanceMatrix[MAX_ROWS][MAX_COLS];
-
-	cJSON_ArrayForEach(rowArray, distanceData) {
-		if (row_idx >= MAX_ROWS) {
-			printf("Too many rows in the JSON data.\n");
-			cJSON_Delete(json);
-			return 1;
-		}
-
-		int col_idx = 0;
-		cJSON_ArrayForEach(cellValue, rowArray) {
-			if (col_idx >= MAX_COLS) {
-				printf("Too many columns in the JSON data.\n");
-				cJSON_Delete(json);
-				return 1;
-			}
-
-			distanceMatrix[row_idx][col_idx] = cellValue->valueint;
-			col_idx++;
-		}
-
-		if (col_idx != cols) {
-			printf("Invalid number of columns in row %d.\n", row_idx);
-			cJSON_Delete(json);
-			return 1;
-		}
-
-		row_idx++;
-	}
-
-	if (row_idx != rows) {
-		printf("Invalid number of rows in the JSON data.\n");
-		cJSON_Delete(json);
-		return 1;
-	}
-
-/*............................................................................*/
-
-	// copying the data from the wait matrix into a C array 
-
-	int wait_row_idx = 0;
-	cJSON *waitRowArray, *waitCellValue;
-	int waitMatrix[MAX_ROWS][MAX_COLS];
-	int wait_rows = 12;
-	int wait_cols = 57;
-
-	cJSON_ArrayForEach(waitRowArray, waitData) {
-		if (wait_row_idx >= MAX_ROWS) {
-			printf("Too many rows in the JSON data.\n");
-			cJSON_Delete(json);
-			return 1;
-		}
-
-		int wait_col_idx = 0;
-		cJSON_ArrayForEach(waitCellValue, waitRowArray) {
-			if (wait_col_idx >= MAX_COLS) {
-				printf("Too many columns in the JSON data.\n");
-				cJSON_Delete(json);
-				return 1;
-			}
-
-			waitMatrix[wait_row_idx][wait_col_idx] = waitCellValue->valueint;
-			wait_col_idx++;
-		}
-
-		if (wait_col_idx != wait_cols) {
-			printf("Invalid number of columns in row %d.\n", wait_row_idx);
-			cJSON_Delete(json);
-			return 1;
-		}
-
-		wait_row_idx++;
-	}
-
-	if (wait_row_idx != wait_rows) {
-		printf("Invalid number of rows in the JSON data.\n");
-		cJSON_Delete(json);
-		return 1;
-	}
-
-/*............................................................................*/
-	
-	// creating an array for the attractions + determining max attraction
-    if (cJSON_IsArray(attractions)) {
-		cJSON *i;
-		int *attractionLabels = malloc(rows * sizeof(int));
-		int index = 0;
+    cJSON *json = readPlanFile("useCase.json");
+    if (json == NULL) {
+        return 1;
+    }
 
+    struct Plan plan;
+    if (loadPlan(json, &plan) != 0) {
+        cJSON_Delete(json);
+        return 1;
+    }
+
+    // the order to start from, Evaluate535Only if the plan has one
+    int arr[MAX_ROWS];
+    cJSON *attractions = cJSON_GetObjectItemCaseSensitive(json, "Evaluate535Only");
+    if (cJSON_GetArraySize(attractions) == plan.length) {
+        int labels[MAX_ROWS];
+        cJSON *i;
+        int index = 0;
         cJSON_ArrayForEach(i, attractions) {
-			*(attractionLabels + index) = i-> valueint;
-			index++;
+            labels[index++] = i->valueint;
         }
-	
-		int maxAttraction = getMax(attractionLabels, rows);
-
-		int rideMatrixTotal = 0;
-		
-		cJSON* rideValue;
-		int *rideMatrixArray = malloc(rows * sizeof(int));
-		int ride = 0;
-
-		cJSON_ArrayForEach(rideValue, rideMatrix) {
-			rideMatrixTotal += rideValue -> valueint;
-			*(rideMatrixArray + ride) = rideValue -> valueint;  // Store the value in the allocated memory
-			ride++;
-		}
-
-        unsigned long** adjustedMatrix = createMatrix(maxAttraction, maxAttraction, distanceMatrix, key, rows);
-        
-        struct StorageResult result = brheap_nonrecur(attractionLabels, rows, key, startTime, adjustedMatrix, waitMatrix, rideMatrixArray);
+        labelsToTour(&plan, labels, arr);
+    } else {
+        memcpy(arr, plan.startTour, plan.length * sizeof(int));
+    }
+    cJSON_Delete(json);
+
+    srand(time(NULL));
+
+    // Heap's algorithm needs at least two attractions between the entrances
+    if (plan.length > 3) {
+        struct TourCache cache;
+        initTourCache(&cache, &plan, 16);
+        struct StorageResult result = useWalk ? plain_changes(&plan, arr) : brheap_nonrecur(&plan, arr, &cache, useLin);
+        freeTourCache(&cache);
 
         int* storage_list = result.storageArray;
         int count = result.count;
@@ -583,8 +673,11 @@ int main() {
 
         // free(storage_list);
         // free(unique);
+
+        free(storage_list);
     
     }
     
+    freePlan(&plan);
     return 0;
 }
\ No newline at end of file
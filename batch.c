@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "functions.h"
+
+
+/* How to use:
+    ./batch [results file] [plan file]...
+
+    solves every plan file the way the fastpass mode of the planner does and
+    writes one json line per plan to the results file ("-" for stdout), in
+    the order they finish:
+
+    {"file":"a.json","planId":7,"cost":493,"tour":[0,12,...,0],"passes":[12],
+     "offTimes":[540,...]}
+
+    a file that can't be read or loaded gets {"file":"b.json","error":"not loaded"}
+
+    reading, solving and writing overlap: BATCH_LOADERS threads (default 1)
+    read and load the files, BATCH_SOLVERS threads (default one per core)
+    solve them and the main thread writes the results. Once every plan is
+    written it prints how long the batch took and how busy each stage was.
+    With results on stdout, that line and every error message go to stderr,
+    so stdout stays pure json lines
+*/
+
+// moves per stop of each solve, as in the fastpass mode
+#define LOOPS_PER_STOP 1000
+
+int main(int argc, char *argv[]) {
+    char *loaders = getenv("BATCH_LOADERS");
+    char *solvers = getenv("BATCH_SOLVERS");
+
+    if (argc < 3) {
+        printf("Usage: %s [results file] [plan file]...\n", argv[0]);
+        return 1;
+    }
+
+    /* results on stdout get a stream of their own on the original stdout,
+       and stdout itself is pointed at stderr for the messages the loaders
+       print */
+    bool toStdout = strcmp(argv[1], "-") == 0;
+    FILE *out;
+    if (toStdout) {
+        int results = dup(STDOUT_FILENO);
+        out = results >= 0 ? fdopen(results, "w") : NULL;
+        if (out != NULL) {
+            fflush(stdout);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+    } else {
+        out = fopen(argv[1], "w");
+    }
+    if (out == NULL) {
+        printf("Error: Unable to open %s.\n", argv[1]);
+        return 1;
+    }
+
+    srand(time(NULL));
+
+    struct BatchStats stats;
+    int result = runBatch(argv + 2, argc - 2, loaders != NULL ? atoi(loaders) : 1, solvers != NULL ? atoi(solvers) : 0,
+        LOOPS_PER_STOP, out, &stats);
+    fclose(out);
+
+    printf("{\"plans\":%d,\"failed\":%d,\"seconds\":%.3f,\"plansPerSec\":%.1f,\"loadSeconds\":%.3f,\"solveSeconds\":%.3f,\"writeSeconds\":%.3f}\n",
+        stats.plans, stats.failed, stats.seconds, stats.seconds > 0 ? stats.plans / stats.seconds : 0,
+        stats.loadSeconds, stats.solveSeconds, stats.writeSeconds);
+    return result != 0 || stats.failed > 0;
+}
@@ -0,0 +1,364 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "functions.h"
+
+
+/* How to use:
+    ./benchmark [largest park] [seed]
+
+    generates synthetic parks of 12, 25, 50, 100 and 150 stops (up to the
+    largest park asked for, default 150), runs every solver mode on each (the
+    exact search only up to MAX_EXACT_STOPS stops) and prints one json
+    object per line:
+
+    {"stops":50,"mode":"fastpass","moves":10000,"seconds":0.01,
+     "movesPerSec":1e6,"timeToBestMs":4.2,"finalCost":612,"peakRssKb":2048}
+
+    moves is the number of candidate moves the solver scored and
+    timeToBestMs is when it last found a better tour, both from the solver
+    counters in metrics.c. finalCost is minutes for the time based modes and
+    total priority for orienteer. `make bench` runs it and keeps the output
+    in bench_output.txt
+*/
+
+#define LOOPS_PER_STOP 200
+#define MEMETIC_GENERATIONS 20
+#define TABU_CACHE_BITS 16
+#define PORTFOLIO_MS 200
+#define ANYTIME_MS 100
+#define SIM_SAMPLES 10000
+#define CACHE_FILE "bench_cache.bin"
+#define CACHE_HITS 10000
+#define GATHERS 1000
+#define GATHER_STOPS 12
+
+// peak resident set size of the process so far, in KB
+static long peakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// prints one benchmark result as a json line, from the counters of the last solve
+static void report(int stops, const char *mode, double finalCost) {
+    double seconds = planMetrics.phaseSeconds[PHASE_SOLVE];
+    long moves = planMetrics.movesEvaluated;
+    printf("{\"stops\":%d,\"mode\":\"%s\",\"moves\":%ld,\"seconds\":%.6f,\"movesPerSec\":%.0f,\"timeToBestMs\":%.3f,\"finalCost\":%.1f,\"peakRssKb\":%ld}\n",
+        stops, mode, moves, seconds, seconds > 0 ? moves / seconds : 0, planMetrics.timeToBest * 1000, finalCost, peakRss());
+    fflush(stdout);
+}
+
+// order and passes together
+static void benchFastPass(const struct Plan *plan) {
+    int tour[MAX_ROWS], groupUsed[MAX_PASS_GROUPS];
+    unsigned char usePass[MAX_ROWS];
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    initPasses(plan, tour, usePass, groupUsed);
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeWithPasses(plan, tour, usePass, LOOPS_PER_STOP * plan->length);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "fastpass", cost);
+}
+
+// the fastpass search run against a deadline of ANYTIME_MS
+static void benchAnytime(const struct Plan *plan) {
+    int tour[MAX_ROWS], groupUsed[MAX_PASS_GROUPS];
+    unsigned char usePass[MAX_ROWS];
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    initPasses(plan, tour, usePass, groupUsed);
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeUntil(plan, tour, usePass, ANYTIME_MS, NULL);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "anytime", cost);
+}
+
+// visit order by variable neighbourhood descent, standby waits only
+static void benchVnd(const struct Plan *plan) {
+    int tour[MAX_ROWS];
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeVnd(plan, tour, NULL);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "vnd", cost);
+}
+
+// visit order by tabu search with a cache of scored tours, standby waits only
+static void benchTabu(const struct Plan *plan) {
+    int tour[MAX_ROWS];
+    struct TourCache cache;
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    initTourCache(&cache, plan, TABU_CACHE_BITS);
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeTabu(plan, tour, NULL, LOOPS_PER_STOP * plan->length, &cache);
+    endPhase(PHASE_SOLVE);
+    freeTourCache(&cache);
+
+    report(plan->length, "tabu", cost);
+}
+
+// the optimal visit order by branch and bound, standby waits only
+static void benchExact(const struct Plan *plan) {
+    int tour[MAX_ROWS];
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = solveExact(plan, NULL, tour);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "exact", cost);
+}
+
+// visit order by the memetic search on every core, standby waits only
+static void benchMemetic(const struct Plan *plan, unsigned int seed) {
+    int tour[MAX_ROWS];
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeMemetic(plan, tour, MEMETIC_GENERATIONS, 0, seed);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "memetic", cost);
+}
+
+/* the memetic search again, every child offered to a set of the MAX_BEST
+   best tours, so the two lines show what keeping alternatives costs */
+static void benchAlternatives(const struct Plan *plan, unsigned int seed) {
+    int tour[MAX_ROWS];
+    struct Plan kept = *plan;
+    struct BestTours *best = (struct BestTours*)malloc(sizeof(struct BestTours));
+
+    initBestTours(best, MAX_BEST);
+    kept.alternatives = best;
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = optimizeMemetic(&kept, tour, MEMETIC_GENERATIONS, 0, seed);
+    endPhase(PHASE_SOLVE);
+    free(best);
+
+    report(plan->length, "memeticAlternatives", cost);
+}
+
+// the walking, waiting and day length front, finalCost is its shortest day
+static void benchPareto(const struct Plan *plan) {
+    struct ParetoFront *front = (struct ParetoFront*)malloc(sizeof(struct ParetoFront));
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    solvePareto(plan, front, LOOPS_PER_STOP * plan->length);
+    endPhase(PHASE_SOLVE);
+
+    int shortest = front->total[0];
+    for (int a = 1; a < front->size; a++) {
+        shortest = front->total[a] < shortest ? front->total[a] : shortest;
+    }
+    free(front);
+
+    report(plan->length, "pareto", shortest);
+}
+
+// every solver raced on its own thread, moves summed over all of them
+static void benchPortfolio(const struct Plan *plan) {
+    struct Portfolio portfolio;
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int cost = solvePortfolio(plan, PORTFOLIO_MS, &portfolio);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "portfolio", cost);
+}
+
+/* SIM_SAMPLES timelines of the starting tour over sampled waits on every
+   core, moves is the timelines and finalCost the 90th percentile day */
+static void benchSimulate(const struct Plan *plan, unsigned int seed) {
+    struct Simulation result;
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    simulateTours(plan, plan->startTour, 1, NULL, SIM_SAMPLES, 0, seed, &result);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "simulate", result.p90 - plan->startTime);
+}
+
+/* CACHE_HITS answers of the plan from a plan cache file, each fingerprinted,
+   looked up and checked against the plan like a repeated request. moves is
+   the hits and finalCost the cached day */
+static void benchCache(const struct Plan *plan) {
+    struct PlanCache cache;
+    int labels[MAX_ROWS], tour[MAX_ROWS];
+    unsigned char passes[MAX_ROWS] = {0}, usePass[MAX_ROWS];
+    int cost = -1;
+
+    unlink(CACHE_FILE);
+    if (openPlanCache(&cache, CACHE_FILE, 10) != 0) {
+        return;
+    }
+    tourToLabels(plan, plan->startTour, labels);
+    storePlan(&cache, planFingerprint(plan, "fastpass"), labels, passes, plan->length, scheduleTour(plan, plan->startTour, NULL, NULL));
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    for (int h = 0; h < CACHE_HITS; h++) {
+        cost = lookupPlan(&cache, planFingerprint(plan, "fastpass"), labels, passes);
+        cost = restoreTour(plan, labels, passes, cost, tour, usePass);
+        planMetrics.movesEvaluated++;
+    }
+    endPhase(PHASE_SOLVE);
+
+    closePlanCache(&cache);
+    unlink(CACHE_FILE);
+    report(plan->length, "cache", cost);
+}
+
+/* GATHERS plans of GATHER_STOPS random stops gathered from the park, moves
+   is the plans built and finalCost their mean starting day */
+static void benchGather(const struct Plan *plan) {
+    struct Park park;
+    int rows[MAX_ROWS], labels[MAX_ROWS];
+    int n = plan->length;
+    int k = n < GATHER_STOPS ? n : GATHER_STOPS;
+    double total = 0;
+
+    // the park borrows the plan's matrices, only its index is its own
+    memset(&park, 0, sizeof(struct Park));
+    park.plan = *plan;
+    indexPark(&park);
+    for (int i = 0; i < n; i++) {
+        rows[i] = i;
+    }
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    for (int g = 0; g < GATHERS; g++) {
+        struct Plan gathered;
+        shuffleArray(rows, n);
+        for (int i = 0; i < k - 1; i++) {
+            labels[i] = plan->key[rows[i]];
+        }
+        labels[k - 1] = plan->key[0];
+
+        gatherPlan(&park, labels, k, plan->startTime, plan->stopTime, &gathered);
+        total += scheduleTour(&gathered, gathered.startTour, NULL, NULL);
+        freePlan(&gathered);
+        planMetrics.movesEvaluated++;
+    }
+    endPhase(PHASE_SOLVE);
+    free(park.rowOfLabel);
+
+    report(n, "gather", total / GATHERS);
+}
+
+// expected time over every wait scenario
+static void benchRobust(const struct Plan *plan) {
+    int tour[MAX_ROWS];
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    double score = optimizeRobust(plan, tour, NULL, OBJECTIVE_EXPECTED, 0, LOOPS_PER_STOP * plan->length);
+    endPhase(PHASE_SOLVE);
+
+    report(plan->length, "robust", score);
+}
+
+// most priority that fits in an eight hour day
+static void benchOrienteer(struct Plan *plan) {
+    struct Route route;
+    int stopTime = plan->stopTime;
+
+    plan->stopTime = plan->startTime + 8 * 60;
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int value = solveOrienteering(plan, plan->length, &route);
+    endPhase(PHASE_SOLVE);
+    plan->stopTime = stopTime;
+
+    report(plan->length, "orienteer", value);
+}
+
+// replanning the second half of the day
+static void benchReplan(const struct Plan *plan) {
+    int offTimes[MAX_ROWS];
+    unsigned char visited[MAX_ROWS] = {0};
+    struct Replan replan;
+    int n = plan->length;
+
+    scheduleTour(plan, plan->startTour, NULL, offTimes);
+    int current = (n - 1) / 2;
+    for (int i = 1; i <= current; i++) {
+        visited[plan->startTour[i]] = 1;
+    }
+
+    resetMetrics();
+    startPhase(PHASE_SOLVE);
+    int finish = replanTour(plan, plan->startTour, visited, plan->startTour[current], offTimes[current] + 20, NULL, LOOPS_PER_STOP * n, &replan);
+    endPhase(PHASE_SOLVE);
+    if (finish < 0) {
+        return;
+    }
+
+    report(n, "replan", finish - plan->startTime);
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = {12, 25, 50, 100, 150};
+    int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    int largest = argc > 1 ? atoi(argv[1]) : MAX_ROWS;
+    unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+
+    for (int i = 0; i < numSizes && sizes[i] <= largest && sizes[i] <= MAX_ROWS; i++) {
+        struct Plan plan;
+        generatePark(&plan, sizes[i], seed + i);
+
+        // every mode starts from the same random sequence
+        srand(seed);
+        benchFastPass(&plan);
+        benchVnd(&plan);
+        benchTabu(&plan);
+        if (plan.length <= MAX_EXACT_STOPS) {
+            benchExact(&plan);
+        }
+        benchMemetic(&plan, seed);
+        benchAlternatives(&plan, seed);
+        // the timed modes draw as many numbers as the clock lets them
+        benchPortfolio(&plan);
+        benchAnytime(&plan);
+        benchPareto(&plan);
+        benchGather(&plan);
+        benchSimulate(&plan, seed);
+        benchCache(&plan);
+        srand(seed);
+        benchRobust(&plan);
+        srand(seed);
+        benchOrienteer(&plan);
+        benchReplan(&plan);
+
+        freePlan(&plan);
+    }
+
+    return 0;
+}
@@ -0,0 +1,362 @@
+// bounds.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* subgradient steps of the 1-tree bound, and the steps without a better
+   bound before the step size is halved */
+#define BOUND_ITERATIONS 100
+#define BOUND_PATIENCE 10
+
+/* cost of an edge no tour can use */
+#define NO_EDGE (1 << 29)
+
+/*............................................................................*/
+
+/* Bound Functions:
+	1. assignmentBound -> cheapest way to give every stop a next stop, which
+	   every tour is one of
+	2. oneTreeBound -> Held-Karp 1-tree bound, tightened by subgradient steps
+	3. walkingBound -> the better of the two, a floor on a tour's walking
+	4. dayBound -> floor on the total time of a plan's day
+	5. optimalityGap -> percent a cost is over a bound
+	6. stopAtGap -> makes the solvers stop once a tour is within a gap of a
+	   bound
+
+   Both walking bounds work on the walk matrix as a cycle through the
+   entrance: node 0 is the entrance (left by its row 0 and reached by its
+   row n - 1) and nodes 1..n - 2 are the attractions. A tour gives every
+   node one next node, so the cheapest such assignment is a bound. The
+   1-tree bound needs one cost per pair, so it uses the cheaper direction,
+   and every tour is a 1-tree of those costs: a spanning tree of the
+   attractions plus two edges to the entrance. Subgradient steps add a
+   penalty to the nodes whose degree in the tree isn't 2, which pushes the
+   cheapest 1-tree toward a tour and raises the bound. A day is the walking
+   plus the ride and wait of every attraction, and waits grow through the
+   morning, so the day bound adds the cheapest assignment of attractions to
+   visit positions, each costed at the shortest wait it could meet in that
+   position, to the walking bound. */
+
+
+// walk from node a to node b of the cycle through the entrance
+static int nodeWalk(const int *walk, int n, int a, int b) {
+	return walk[a * n + (b == 0 ? n - 1 : b)];
+}
+
+/* cheapest way to give each of the m rows of an m x m cost matrix its own
+   column (Hungarian algorithm, O(m^3)) */
+static int cheapestAssignment(const int *cost, int m) {
+	int u[MAX_ROWS + 1] = {0}, v[MAX_ROWS + 1] = {0};
+	int match[MAX_ROWS + 1] = {0}, way[MAX_ROWS + 1] = {0};
+	int minv[MAX_ROWS + 1];
+	char used[MAX_ROWS + 1];
+
+	// rows and columns are numbered from 1 here, match[j] is the row of column j
+	for (int i = 1; i <= m; i++) {
+		int j0 = 0;
+		match[0] = i;
+		for (int j = 0; j <= m; j++) {
+			minv[j] = NO_EDGE;
+			used[j] = 0;
+		}
+
+		do {
+			used[j0] = 1;
+			int i0 = match[j0], delta = NO_EDGE, j1 = 0;
+			for (int j = 1; j <= m; j++) {
+				if (used[j]) {
+					continue;
+				}
+				int reduced = cost[(i0 - 1) * m + j - 1] - u[i0] - v[j];
+				if (reduced < minv[j]) {
+					minv[j] = reduced;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= m; j++) {
+				if (used[j]) {
+					u[match[j]] += delta;
+					v[j] -= delta;
+				} else {
+					minv[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (match[j0] != 0);
+
+		// flips the augmenting path back to the root
+		do {
+			int j1 = way[j0];
+			match[j0] = match[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	int total = 0;
+	for (int j = 1; j <= m; j++) {
+		total += cost[(match[j] - 1) * m + j - 1];
+	}
+	return total;
+}
+
+/* cheapest way to pick a next node for every node, each node picked once
+   and never itself */
+int assignmentBound(const int *walk, int n) {
+	int m = n - 1;
+
+	if (n < 3) {
+		return 0;
+	}
+
+	int *cost = (int*)malloc(m * m * sizeof(int));
+	for (int a = 0; a < m; a++) {
+		for (int b = 0; b < m; b++) {
+			cost[a * m + b] = (a == b) ? NO_EDGE : nodeWalk(walk, n, a, b);
+		}
+	}
+	int total = cheapestAssignment(cost, m);
+	free(cost);
+	return total;
+}
+
+/* cost of the cheapest 1-tree under the node penalties pi, with the degree
+   of every node in it */
+static double cheapestOneTree(const int *walk, int n, const double *pi, int *degree) {
+	int m = n - 1;
+	double dist[MAX_ROWS];
+	int parent[MAX_ROWS];
+	char inTree[MAX_ROWS] = {0};
+	double total = 0;
+
+	memset(degree, 0, m * sizeof(int));
+
+	// spanning tree of the attractions (Prim on the dense matrix)
+	inTree[1] = 1;
+	for (int b = 2; b < m; b++) {
+		dist[b] = fmin(nodeWalk(walk, n, 1, b), nodeWalk(walk, n, b, 1)) + pi[1] + pi[b];
+		parent[b] = 1;
+	}
+	for (int k = 2; k < m; k++) {
+		int next = -1;
+		for (int b = 2; b < m; b++) {
+			if (!inTree[b] && (next < 0 || dist[b] < dist[next])) {
+				next = b;
+			}
+		}
+		inTree[next] = 1;
+		total += dist[next];
+		degree[next]++;
+		degree[parent[next]]++;
+		for (int b = 2; b < m; b++) {
+			double d = fmin(nodeWalk(walk, n, next, b), nodeWalk(walk, n, b, next)) + pi[next] + pi[b];
+			if (!inTree[b] && d < dist[b]) {
+				dist[b] = d;
+				parent[b] = next;
+			}
+		}
+	}
+
+	// and the two cheapest edges to the entrance
+	int first = -1, second = -1;
+	double firstCost = 0, secondCost = 0;
+	for (int b = 1; b < m; b++) {
+		double d = fmin(nodeWalk(walk, n, 0, b), nodeWalk(walk, n, b, 0)) + pi[0] + pi[b];
+		if (first < 0 || d < firstCost) {
+			second = first;
+			secondCost = firstCost;
+			first = b;
+			firstCost = d;
+		} else if (second < 0 || d < secondCost) {
+			second = b;
+			secondCost = d;
+		}
+	}
+	total += firstCost + secondCost;
+	degree[0] = 2;
+	degree[first]++;
+	degree[second]++;
+
+	for (int a = 0; a < m; a++) {
+		total -= 2 * pi[a];
+	}
+	return total;
+}
+
+/* Held-Karp bound: the cheapest 1-tree, raised by BOUND_ITERATIONS
+   subgradient steps. upper is the walking of any tour, it only sets the
+   step size */
+int oneTreeBound(const int *walk, int n, int upper) {
+	int m = n - 1;
+	double pi[MAX_ROWS] = {0};
+	int degree[MAX_ROWS];
+	double best = 0, step = 2;
+	int stale = 0;
+
+	// with two attractions or fewer there's nothing to bound
+	if (m < 3) {
+		return 0;
+	}
+
+	for (int it = 0; it < BOUND_ITERATIONS; it++) {
+		double bound = cheapestOneTree(walk, n, pi, degree);
+		if (bound > best + 1e-9) {
+			best = bound;
+			stale = 0;
+		} else if (++stale >= BOUND_PATIENCE) {
+			step /= 2;
+			stale = 0;
+		}
+
+		int norm = 0;
+		for (int a = 0; a < m; a++) {
+			norm += (degree[a] - 2) * (degree[a] - 2);
+		}
+		// every degree is 2, the 1-tree is a tour and the bound is exact
+		if (norm == 0 || upper <= bound) {
+			break;
+		}
+
+		double t = step * (upper - bound) / norm;
+		for (int a = 0; a < m; a++) {
+			pi[a] += t * (degree[a] - 2);
+		}
+	}
+
+	// tour costs are whole minutes
+	return (int)ceil(best - 1e-6);
+}
+
+/* floor on the walking minutes of any tour of the n x n walk matrix (rows
+   0 and n - 1 are the entrance). upper is the walking of any tour */
+int walkingBound(const int *walk, int n, int upper) {
+	int assignment = assignmentBound(walk, n);
+	int oneTree = oneTreeBound(walk, n, upper);
+	return assignment > oneTree ? assignment : oneTree;
+}
+
+/* shortest walk from row "from" to every row (to "from" from every row when
+   reverse is set), over any number of stops (Dijkstra on the dense matrix) */
+static void shortestWalks(const int *walk, int n, int from, int reverse, int *dist) {
+	char done[MAX_ROWS] = {0};
+
+	for (int i = 0; i < n; i++) {
+		dist[i] = reverse ? walk[i * n + from] : walk[from * n + i];
+	}
+	dist[from] = 0;
+	done[from] = 1;
+
+	for (int k = 1; k < n; k++) {
+		int next = -1;
+		for (int i = 0; i < n; i++) {
+			if (!done[i] && (next < 0 || dist[i] < dist[next])) {
+				next = i;
+			}
+		}
+		done[next] = 1;
+		for (int i = 0; i < n; i++) {
+			int d = dist[next] + (reverse ? walk[i * n + next] : walk[next * n + i]);
+			if (!done[i] && d < dist[i]) {
+				dist[i] = d;
+			}
+		}
+	}
+}
+
+// the wait table column for a time of day, like tableAt()
+static int sliceOf(const struct Plan *plan, int time) {
+	int s = (time - plan->matrixStart) / plan->segment;
+	if (s < 0) {
+		return 0;
+	}
+	return s < plan->numSlices ? s : plan->numSlices - 1;
+}
+
+// for qsort, ascending
+static int ascending(const void *a, const void *b) {
+	return *(const int*)a - *(const int*)b;
+}
+
+/* floor on the total time of the plan's day: the walking bound plus the
+   rides and waits. The attraction visited k-th can't be reached before k
+   walks and k - 1 rides have passed, at least the shortest walk and the
+   k - 1 shortest rides, and has to be left in time to get back before a
+   day of "upper" minutes ends. So each attraction's wait at each position
+   is at least the shortest wait in that window, and the cheapest
+   assignment of attractions to positions is a floor on the rides and
+   waits. With usePasses the wait of a row that can take a pass may be its
+   return-window wait. upper is the total time of any tour */
+int dayBound(const struct Plan *plan, int usePasses, int upper) {
+	int n = plan->length;
+	int m = n - 2;
+	int slices = plan->numSlices;
+	int fromEntrance[MAX_ROWS], toEntrance[MAX_ROWS], rides[MAX_ROWS];
+	int bound = walkingBound(plan->walk, n, walkingCost(plan, plan->startTour, n));
+
+	if (m < 1) {
+		return bound;
+	}
+
+	shortestWalks(plan->walk, n, 0, 0, fromEntrance);
+	shortestWalks(plan->walk, n, n - 1, 1, toEntrance);
+
+	int shortestWalk = NO_EDGE;
+	for (int a = 0; a < n; a++) {
+		for (int b = 1; b < n - 1; b++) {
+			if (a != b && plan->walk[a * n + b] < shortestWalk) {
+				shortestWalk = plan->walk[a * n + b];
+			}
+		}
+	}
+	memcpy(rides, plan->rideTime + 1, m * sizeof(int));
+	qsort(rides, m, sizeof(int), ascending);
+
+	// cost[i * m + k] is the ride and least wait of attraction i + 1 visited (k + 1)-th
+	int *cost = (int*)malloc(m * m * sizeof(int));
+	for (int i = 1; i < n - 1; i++) {
+		int last = sliceOf(plan, plan->startTime + upper - plan->rideTime[i] - toEntrance[i]);
+		int ridden = 0;
+
+		for (int k = 1; k <= m; k++) {
+			int walked = k * shortestWalk > fromEntrance[i] ? k * shortestWalk : fromEntrance[i];
+			int first = sliceOf(plan, plan->startTime + walked + ridden);
+			int shortest = plan->waitTable[i * slices + first];
+			for (int s = first; s <= (last > first ? last : first); s++) {
+				if (plan->waitTable[i * slices + s] < shortest) {
+					shortest = plan->waitTable[i * slices + s];
+				}
+				if (usePasses && plan->passGroup[i] >= 0 && plan->returnTable[i * slices + s] < shortest) {
+					shortest = plan->returnTable[i * slices + s];
+				}
+			}
+			cost[(i - 1) * m + k - 1] = plan->rideTime[i] + shortest;
+			ridden += rides[k - 1];
+		}
+	}
+	bound += cheapestAssignment(cost, m);
+	free(cost);
+	return bound;
+}
+
+// percent the cost is over the bound, 0 without a bound
+double optimalityGap(int cost, int bound) {
+	if (bound <= 0) {
+		return 0;
+	}
+	return 100.0 * (cost - bound) / bound;
+}
+
+/* makes the solvers stop as soon as their best tour is within percent of the
+   bound, which proves it is at most that far from optimal. A negative
+   percent turns the early stop off */
+void stopAtGap(struct Plan *plan, int bound, double percent) {
+	plan->stopCost = percent < 0 ? 0 : (int)(bound * (1 + percent / 100));
+}
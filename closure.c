@@ -0,0 +1,208 @@
+// closure.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* side of the square tiles the matrix is relaxed in, 16 ints is one cache
+   line and three tiles stay in L1 */
+#define CLOSURE_BLOCK 16
+
+/* walk of the padding rows and columns, no path goes through them and two
+   of them still add up without overflow */
+#define CLOSURE_FAR (1 << 29)
+
+/* parks whose closure is kept for the next plan of the same park */
+#define CLOSURE_CACHE_SIZE 4
+
+/*............................................................................*/
+
+/* Closure Functions:
+	1. relaxRow -> shortens one tile row through one intermediate stop
+	2. relaxTile -> runs one tile through a block of intermediate stops
+	3. closeWalks -> shortest walk between every pair of stops over any
+	   number of intermediate stops (blocked Floyd-Warshall)
+	4. closePlanWalks -> replaces a plan's walk matrix with its closure,
+	   through the per-park cache
+	5. walkPath -> the stops a shortest walk passes on the way
+
+   DistanceMatrix is taken as given, but a walk through a third attraction
+   can be shorter than the direct entry, and the bounds, the walking deltas
+   and the exact search's cut all assume the triangle inequality. So the
+   walk matrix is closed when the plan is loaded: every entry becomes the
+   shortest walk over any number of stops, and walkVia records one stop on
+   that walk (-1 for the direct walk) so the schedule can say which stops
+   the guest walks past.
+
+   Floyd-Warshall is run on CLOSURE_BLOCK square tiles of a copy padded to
+   a multiple of the tile. For each block of intermediate stops the
+   diagonal tile goes first, then the tiles in its row and column, then the
+   rest, which gives the same distances as the plain triple loop while each
+   phase works on three tiles that stay in cache. The innermost loop is a
+   straight, branch-free run over one tile row with restrict pointers, so
+   the compiler vectorizes it.
+
+   The closure of the last CLOSURE_CACHE_SIZE distinct walk matrices is
+   kept, keyed by the raw matrix, so plans of a park already seen copy it
+   instead of closing it again. The cache is shared by every plan in the
+   process and locked while it is used; plans always get their own copy. */
+
+
+// a park's walk matrix as it was read, and its closure
+struct ClosureEntry {
+	int n;                      // 0 for an empty entry
+	unsigned long long hash;    // of the raw matrix
+	int *walk;                  // raw matrix
+	int *dist;                  // its closure
+	int *via;
+	int shortened;              // pairs a detour made shorter
+};
+
+static struct ClosureEntry closureCache[CLOSURE_CACHE_SIZE];
+static int nextEntry;
+static pthread_mutex_t closureLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* relaxes one tile row through stop k: toJ[j] = min(toJ[j], toK + fromK[j]),
+   recording k in via where it wins */
+static void relaxRow(int *restrict toJ, int *restrict via, const int *restrict fromK, int toK, int k) {
+	for (int j = 0; j < CLOSURE_BLOCK; j++) {
+		int detour = toK + fromK[j];
+		int shorter = detour < toJ[j];
+		toJ[j] = shorter ? detour : toJ[j];
+		via[j] = shorter ? k : via[j];
+	}
+}
+
+/* relaxes the tile at (row, col) of the padded m x m matrix through every
+   stop of the block starting at k0. Row k itself can't get shorter through
+   k, so it is skipped, which keeps the rows relaxRow gets apart */
+static void relaxTile(int *dist, int *via, int m, int row, int col, int k0) {
+	for (int k = k0; k < k0 + CLOSURE_BLOCK; k++) {
+		const int *fromK = dist + k * m + col;
+		for (int i = row; i < row + CLOSURE_BLOCK; i++) {
+			if (i != k) {
+				relaxRow(dist + i * m + col, via + i * m + col, fromK, dist[i * m + k], k);
+			}
+		}
+	}
+}
+
+/* shortest walk between every pair of the n stops of walk, over any number
+   of intermediate stops. dist gets the walks (it may be walk itself) and
+   via one intermediate stop of each, -1 when the direct walk is shortest.
+   Returns the number of pairs a detour made shorter */
+int closeWalks(const int *walk, int n, int *dist, int *via) {
+	int m = (n + CLOSURE_BLOCK - 1) / CLOSURE_BLOCK * CLOSURE_BLOCK;
+	int *padded = (int*)malloc(m * m * sizeof(int));
+	int *paddedVia = (int*)malloc(m * m * sizeof(int));
+
+	for (int i = 0; i < m; i++) {
+		for (int j = 0; j < m; j++) {
+			padded[i * m + j] = (i < n && j < n) ? walk[i * n + j] : CLOSURE_FAR;
+			paddedVia[i * m + j] = -1;
+		}
+	}
+
+	for (int k0 = 0; k0 < m; k0 += CLOSURE_BLOCK) {
+		relaxTile(padded, paddedVia, m, k0, k0, k0);
+		for (int t = 0; t < m; t += CLOSURE_BLOCK) {
+			if (t != k0) {
+				relaxTile(padded, paddedVia, m, k0, t, k0);
+				relaxTile(padded, paddedVia, m, t, k0, k0);
+			}
+		}
+		for (int r = 0; r < m; r += CLOSURE_BLOCK) {
+			for (int c = 0; c < m; c += CLOSURE_BLOCK) {
+				if (r != k0 && c != k0) {
+					relaxTile(padded, paddedVia, m, r, c, k0);
+				}
+			}
+		}
+	}
+
+	int shortened = 0;
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < n; j++) {
+			if (i != j && padded[i * m + j] < walk[i * n + j]) {
+				shortened++;
+			}
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		memcpy(dist + i * n, padded + i * m, n * sizeof(int));
+		memcpy(via + i * n, paddedVia + i * m, n * sizeof(int));
+	}
+
+	free(padded);
+	free(paddedVia);
+	return shortened;
+}
+
+/* replaces plan->walk with its closure and fills plan->walkVia, from the
+   cache when the same walk matrix was closed before. Returns the number of
+   pairs a detour made shorter */
+int closePlanWalks(struct Plan *plan) {
+	int n = plan->length;
+	size_t size = n * n * sizeof(int);
+	unsigned long long hash = fnvInts(FNV_OFFSET, plan->walk, n * n);
+
+	pthread_mutex_lock(&closureLock);
+	for (int e = 0; e < CLOSURE_CACHE_SIZE; e++) {
+		struct ClosureEntry *entry = &closureCache[e];
+		if (entry->n == n && entry->hash == hash && memcmp(entry->walk, plan->walk, size) == 0) {
+			memcpy(plan->walk, entry->dist, size);
+			memcpy(plan->walkVia, entry->via, size);
+			pthread_mutex_unlock(&closureLock);
+			return entry->shortened;
+		}
+	}
+
+	// the oldest entry makes way
+	struct ClosureEntry *entry = &closureCache[nextEntry];
+	nextEntry = (nextEntry + 1) % CLOSURE_CACHE_SIZE;
+	free(entry->walk);
+	free(entry->dist);
+	free(entry->via);
+	entry->n = n;
+	entry->hash = hash;
+	entry->walk = (int*)malloc(size);
+	entry->dist = (int*)malloc(size);
+	entry->via = (int*)malloc(size);
+	memcpy(entry->walk, plan->walk, size);
+	entry->shortened = closeWalks(entry->walk, n, entry->dist, entry->via);
+
+	memcpy(plan->walk, entry->dist, size);
+	memcpy(plan->walkVia, entry->via, size);
+	pthread_mutex_unlock(&closureLock);
+	return entry->shortened;
+}
+
+/* the rows a shortest walk from row "from" to row "to" passes, in order and
+   without the two ends. Returns how many there are */
+int walkPath(const struct Plan *plan, int from, int to, int *stops) {
+	int n = plan->length;
+	int stack[MAX_ROWS];
+	int depth = 0, count = 0;
+
+	// walks [from, to] left to right, splitting each leg at its via stop
+	stack[depth++] = to;
+	while (depth > 0 && count < n) {
+		int end = stack[depth - 1];
+		int k = plan->walkVia[from * n + end];
+		if (k >= 0 && depth < MAX_ROWS) {
+			stack[depth++] = k;
+			continue;
+		}
+		depth--;
+		if (end != to) {
+			stops[count++] = end;
+		}
+		from = end;
+	}
+	return count;
+}
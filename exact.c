@@ -0,0 +1,105 @@
+// exact.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/*............................................................................*/
+
+/* Exact Functions:
+	1. extendExact -> depth-first search over every visit order, building the
+	   timeline one stop at a time
+	2. solveExact -> the shortest day over every order of the attractions,
+	   the reference the heuristic solvers are measured against
+
+   Like allPermutations.c this tries every order, but each order shares its
+   prefix timeline with its neighbours instead of being rescheduled from the
+   start, and a prefix is dropped once it already ends after the best full
+   day found. Waits are never negative and every walk takes at least a
+   minute, so off times only grow along a tour and the cut never loses the
+   optimum. In a portfolio race the cut is the shortest day any strategy
+   has found, so a search that runs to the end proves that day optimal.
+
+   With plan->alternatives set every full order is offered to it and the
+   cut is the k-th best day kept instead, so the search returns the k best
+   orders there are, not just the best. */
+
+
+/* places every unused row at position "depth" after a prefix that ends at
+   off_time, and recurses. best and bestTour hold the shortest full day */
+static void extendExact(const struct Plan *plan, const unsigned char *usePass, int *tour, bool *used, int depth, int off_time, int *best, int *bestTour) {
+	int n = plan->length;
+	int prev = tour[depth - 1];
+
+	if (depth == n - 1) {
+		int finish = off_time + plan->walk[prev * n + tour[n - 1]] - plan->startTime;
+		planMetrics.movesEvaluated++;
+		if (plan->alternatives != NULL) {
+			offerBestTour(plan->alternatives, tour, n, finish);
+		}
+		if (finish < *best) {
+			*best = finish;
+			memcpy(bestTour, tour, n * sizeof(int));
+			noteImprovement();
+		}
+		return;
+	}
+	if (!keepSearching(plan, *best)) {
+		return;
+	}
+
+	// the other strategies of a race may already know a shorter day
+	int cut = raceIncumbent(plan, *best);
+	if (plan->alternatives != NULL) {
+		cut = bestToursLimit(plan->alternatives);
+	}
+	for (int row = 1; row < n - 1; row++) {
+		if (used[row]) {
+			continue;
+		}
+
+		int arrival_time = off_time + plan->walk[prev * n + row];
+		const int *table = (usePass != NULL && usePass[row]) ? plan->returnTable : plan->waitTable;
+		int next_off = arrival_time + tableAt(plan, table, row, arrival_time) + plan->rideTime[row];
+
+		// no order starting with this prefix can beat the cut
+		if (next_off - plan->startTime >= cut) {
+			continue;
+		}
+
+		used[row] = true;
+		tour[depth] = row;
+		extendExact(plan, usePass, tour, used, depth + 1, next_off, best, bestTour);
+		used[row] = false;
+	}
+}
+
+/* the shortest day over every order of the attractions, with the passes in
+   usePass (NULL for standby only). tour gets the optimal order. Plans with
+   more than MAX_EXACT_STOPS stops are refused, returns the total time or
+   RESULT_ERROR. Stops early, without proof, when its race ends. With
+   plan->alternatives set it also gets the k best orders */
+int solveExact(const struct Plan *plan, const unsigned char *usePass, int *tour) {
+	int n = plan->length;
+	int work[MAX_ROWS];
+	bool used[MAX_ROWS] = {false};
+
+	if (n > MAX_EXACT_STOPS) {
+		printf("Error: exact solve is limited to %d stops, plan has %d.\n", MAX_EXACT_STOPS, n);
+		return RESULT_ERROR;
+	}
+
+	// the starting tour is the first bound
+	memcpy(tour, plan->startTour, n * sizeof(int));
+	memcpy(work, plan->startTour, n * sizeof(int));
+	int best = scheduleTour(plan, tour, usePass, NULL);
+
+	extendExact(plan, usePass, work, used, 1, plan->startTime, &best, tour);
+	return best;
+}
@@ -0,0 +1,316 @@
+// fastPass.c
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* moves made between two looks at the clock by optimizeUntil, small enough
+   that a batch on a 150 stop park takes well under a millisecond */
+#define DEADLINE_BATCH 64
+
+/*............................................................................*/
+
+/* FastPass Functions:
+	1. loadFastPass -> reads the return-time pass fields of a plan and
+	   precomputes the return-window table next to the standby wait table
+	2. initPasses -> turns on the passes that are already decided
+	   (ReservedFP, FPOnly, ForceFastpass)
+	3. optimizeWithPasses -> searches visit order and which stops use a pass
+	   at the same time, scoring every move incrementally
+	4. optimizeUntil -> the same search run against a wall-clock deadline
+	   instead of a move count, recording a convergence trace
+
+   FastpassReturn has the same shape as WaitMatrix and holds the minutes a
+   guest holding a pass waits at that attraction in each timeslice (the wait
+   for the return window to open plus the return line). Only attractions in
+   one of the FPPGroups can take a pass, and each group can hand out at most
+   its FPPGroupLimits entry, minus what is already used in CompletedFP.
+   UseMaxPass only changes how guests book, so the same limits apply. */
+
+
+// sets the flag for every row whose attraction is listed in a json label array
+static void markRows(const cJSON *labels, const struct Plan *plan, unsigned char *flags) {
+	cJSON *item;
+	cJSON_ArrayForEach(item, labels) {
+		int row = findRow(plan, parseLabel(item));
+		if (row > 0) {
+			flags[row] = 1;
+		}
+	}
+}
+
+/* reads the return-time pass fields of a plan and precomputes the
+   return-window table. Plans without FastpassReturn get a copy of the standby
+   table and no eligible rows, so every solver can use passes unconditionally */
+int loadFastPass(const cJSON *json, struct Plan *plan) {
+	int n = plan->length;
+	int slices = plan->numSlices;
+
+	cJSON *returnData = cJSON_GetObjectItemCaseSensitive(json, "FastpassReturn");
+	if (cJSON_GetArraySize(returnData) == 0) {
+		memcpy(plan->returnTable, plan->waitTable, n * slices * sizeof(int));
+		return 0;
+	}
+
+	if (readMatrix(returnData, n, slices, plan->scratchTable, "FastpassReturn") != 0) {
+		return RESULT_ERROR;
+	}
+	buildWaitTable(plan->scratchTable, n, slices, plan->returnTable);
+
+	// group membership and limits
+	cJSON *groups = cJSON_GetObjectItemCaseSensitive(json, "FPPGroups");
+	cJSON *limits = cJSON_GetObjectItemCaseSensitive(json, "FPPGroupLimits");
+	plan->numGroups = cJSON_GetArraySize(groups);
+	if (plan->numGroups > MAX_PASS_GROUPS) {
+		printf("Error: a plan can have at most %d FPPGroups.\n", MAX_PASS_GROUPS);
+		return RESULT_ERROR;
+	}
+
+	for (int g = 0; g < plan->numGroups; g++) {
+		cJSON *limit = cJSON_GetArrayItem(limits, g);
+		plan->groupLimit[g] = cJSON_IsNumber(limit) ? limit->valueint : 1;
+
+		cJSON *item;
+		cJSON_ArrayForEach(item, cJSON_GetArrayItem(groups, g)) {
+			int row = findRow(plan, parseLabel(item));
+			if (row > 0) {
+				plan->passGroup[row] = g;
+			}
+		}
+	}
+
+	// passes already used today count against their group
+	cJSON *item;
+	cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(json, "CompletedFP")) {
+		int row = findRow(plan, parseLabel(item));
+		if (row > 0 && plan->passGroup[row] >= 0 && plan->groupLimit[plan->passGroup[row]] > 0) {
+			plan->groupLimit[plan->passGroup[row]]--;
+		}
+	}
+
+	// reserved passes and pass-only attractions always ride with a pass
+	markRows(cJSON_GetObjectItemCaseSensitive(json, "ReservedFP"), plan, plan->passFixed);
+	markRows(cJSON_GetObjectItemCaseSensitive(json, "FPOnly"), plan, plan->passFixed);
+
+	cJSON *force = cJSON_GetObjectItemCaseSensitive(json, "ForceFastpass");
+	plan->forcePasses = cJSON_IsNumber(force) && force->valueint != 0;
+
+	return 0;
+}
+
+/* turns on the passes that are already decided. groupUsed gets the number of
+   passes taken from each group */
+void initPasses(const struct Plan *plan, const int *tour, unsigned char *usePass, int *groupUsed) {
+	memset(usePass, 0, plan->length * sizeof(unsigned char));
+	memset(groupUsed, 0, MAX_PASS_GROUPS * sizeof(int));
+
+	for (int i = 1; i < plan->length - 1; i++) {
+		int row = tour[i];
+		int g = plan->passGroup[row];
+
+		if (plan->passFixed[row]) {
+			usePass[row] = 1;
+			if (g >= 0) {
+				groupUsed[g]++;
+			}
+		}
+	}
+
+	// ForceFastpass hands out passes in visit order until the groups run out
+	if (plan->forcePasses) {
+		for (int i = 1; i < plan->length - 1; i++) {
+			int row = tour[i];
+			int g = plan->passGroup[row];
+			if (g >= 0 && !usePass[row] && groupUsed[g] < plan->groupLimit[g]) {
+				usePass[row] = 1;
+				groupUsed[g]++;
+			}
+		}
+	}
+}
+
+// true if the search may turn the pass of this row on or off
+static bool canToggle(const struct Plan *plan, int row) {
+	return plan->passGroup[row] >= 0 && !plan->passFixed[row];
+}
+
+/* tries turning the pass at position i on or off, keeping it if the day gets
+   shorter. Only the timeline from i on is rescored */
+static int tryToggle(const struct Plan *plan, const int *tour, unsigned char *usePass, int *groupUsed, int *offTimes, int *trialTimes, int i, int cost) {
+	int row = tour[i];
+	int g = plan->passGroup[row];
+
+	if (!canToggle(plan, row)) {
+		return cost;
+	}
+	if (usePass[row] && plan->forcePasses) {
+		return cost;
+	}
+	if (!usePass[row] && groupUsed[g] >= plan->groupLimit[g]) {
+		return cost;
+	}
+
+	usePass[row] ^= 1;
+	int new_cost = evaluateSuffix(plan, tour, usePass, offTimes, trialTimes, i, i + 1);
+
+	if (new_cost < cost) {
+		planMetrics.movesAccepted++;
+		noteImprovement();
+		groupUsed[g] += usePass[row] ? 1 : -1;
+		rescheduleFrom(plan, tour, usePass, offTimes, i);
+		return new_cost;
+	}
+
+	usePass[row] ^= 1;
+	return cost;
+}
+
+/* counts the passes already handed out, scores the tour and makes one greedy
+   pass sweep so the random search starts from a sensible pass set. Returns
+   the number of rows that can take a pass */
+static int startSearch(const struct Plan *plan, int *tour, unsigned char *usePass, int *groupUsed, int *offTimes, int *trialTimes, int *cost) {
+	int n = plan->length;
+	int eligible = 0;
+
+	memset(groupUsed, 0, MAX_PASS_GROUPS * sizeof(int));
+	for (int i = 1; i < n - 1; i++) {
+		int row = tour[i];
+		if (canToggle(plan, row)) {
+			eligible++;
+		}
+		if (usePass[row] && plan->passGroup[row] >= 0) {
+			groupUsed[plan->passGroup[row]]++;
+		}
+	}
+
+	*cost = scheduleTour(plan, tour, usePass, offTimes);
+	for (int i = 1; i < n - 1; i++) {
+		*cost = tryToggle(plan, tour, usePass, groupUsed, offTimes, trialTimes, i, *cost);
+	}
+	return eligible;
+}
+
+/* makes one random move: reverse a segment of the tour, turn one pass on or
+   off, or hand a group's pass to another stop in the same group. The move is
+   kept only if the day gets shorter, returns the new total time */
+static int randomMove(const struct Plan *plan, int *tour, unsigned char *usePass, int *groupUsed, int *offTimes, int *trialTimes, int eligible, int cost) {
+	int n = plan->length;
+	int move = eligible > 0 ? rand() % 3 : 0;
+	int p1 = (rand() % (n - 2)) + 1;
+	int p2 = p1;
+	while (p2 == p1 && n > 3) {
+		p2 = (rand() % (n - 2)) + 1;
+	}
+	int lo = p1 < p2 ? p1 : p2;
+	int hi = p1 < p2 ? p2 : p1;
+
+	if (move == 0) {
+		// reverse tour[lo..hi], passes stay with their attraction
+		for (int a = lo, b = hi; a < b; a++, b--) {
+			swap(&tour[a], &tour[b]);
+		}
+		int new_cost = evaluateSuffix(plan, tour, usePass, offTimes, trialTimes, lo, hi + 1);
+
+		if (new_cost < cost) {
+			planMetrics.movesAccepted++;
+			noteImprovement();
+			rescheduleFrom(plan, tour, usePass, offTimes, lo);
+			return new_cost;
+		}
+		for (int a = lo, b = hi; a < b; a++, b--) {
+			swap(&tour[a], &tour[b]);
+		}
+		return cost;
+	}
+
+	if (move == 1) {
+		return tryToggle(plan, tour, usePass, groupUsed, offTimes, trialTimes, p1, cost);
+	}
+
+	// move a pass between two stops of the same group
+	int r1 = tour[lo];
+	int r2 = tour[hi];
+	if (!canToggle(plan, r1) || !canToggle(plan, r2)
+		|| plan->passGroup[r1] != plan->passGroup[r2] || usePass[r1] == usePass[r2]) {
+		return cost;
+	}
+
+	usePass[r1] ^= 1;
+	usePass[r2] ^= 1;
+	int new_cost = evaluateSuffix(plan, tour, usePass, offTimes, trialTimes, lo, hi + 1);
+
+	if (new_cost < cost) {
+		planMetrics.movesAccepted++;
+		noteImprovement();
+		rescheduleFrom(plan, tour, usePass, offTimes, lo);
+		return new_cost;
+	}
+	usePass[r1] ^= 1;
+	usePass[r2] ^= 1;
+	return cost;
+}
+
+/* searches visit order and which stops use a pass at the same time, making
+   maxLoops random moves. Every move is scored from the first position it
+   changes using the current timeline, so pass choices cost a partial
+   reschedule instead of a full solve per pass subset. tour and usePass are
+   updated in place, returns the total time */
+int optimizeWithPasses(const struct Plan *plan, int *tour, unsigned char *usePass, int maxLoops) {
+	int offTimes[MAX_ROWS], trialTimes[MAX_ROWS];
+	int groupUsed[MAX_PASS_GROUPS];
+	int cost;
+
+	int eligible = startSearch(plan, tour, usePass, groupUsed, offTimes, trialTimes, &cost);
+
+	// stops early once the tour is as close to the bound as the caller asked
+	while (maxLoops-- > 0 && keepSearching(plan, cost)) {
+		cost = randomMove(plan, tour, usePass, groupUsed, offTimes, trialTimes, eligible, cost);
+	}
+
+	return cost;
+}
+
+/* the same search, run until deadlineMs milliseconds have passed instead of
+   for a fixed number of moves. The clock is read once per DEADLINE_BATCH
+   moves, and the search only ever keeps improving moves, so tour and usePass
+   always hold the best tour found when the deadline hits. trace (optional)
+   gets the starting cost and every improvement, stamped at the end of the
+   batch that found it. Both searches stop early once the tour takes
+   plan->stopCost or less (see stopAtGap), or when their portfolio race
+   ends. Returns the total time */
+int optimizeUntil(const struct Plan *plan, int *tour, unsigned char *usePass, int deadlineMs, struct Trace *trace) {
+	int offTimes[MAX_ROWS], trialTimes[MAX_ROWS];
+	int groupUsed[MAX_PASS_GROUPS];
+	int cost;
+
+	double start = wallClock();
+	double deadline = start + deadlineMs / 1000.0;
+
+	int eligible = startSearch(plan, tour, usePass, groupUsed, offTimes, trialTimes, &cost);
+	double now = wallClock();
+	if (trace != NULL) {
+		trace->length = 0;
+		addTrace(trace, now - start, cost);
+	}
+
+	while (now < deadline && keepSearching(plan, cost)) {
+		int batch_cost = cost;
+		for (int m = 0; m < DEADLINE_BATCH; m++) {
+			cost = randomMove(plan, tour, usePass, groupUsed, offTimes, trialTimes, eligible, cost);
+		}
+		now = wallClock();
+
+		if (trace != NULL && cost < batch_cost) {
+			addTrace(trace, now - start, cost);
+		}
+	}
+
+	return cost;
+}
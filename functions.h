@@ -2,11 +2,309 @@
 
 #ifndef FUNCTIONS_H
 #define FUNCTIONS_H
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+
 #define MAX_ROWS 150
 #define MAX_COLS 150
 
 #define MAX_TOUR 15
 
+/* FPPGroups a single plan can carry */
+#define MAX_PASS_GROUPS 16
+
+/* phases of a plan timed by metrics.c */
+#define PHASE_READ 0
+#define PHASE_PARSE 1
+#define PHASE_MATRIX 2
+#define PHASE_SOLVE 3
+#define PHASE_SCHEDULE 4
+#define PHASE_OUTPUT 5
+#define NUM_PHASES 6
+
+/* longest tour with its own length-specialized kernels in kernels.c */
+#define MAX_KERNEL_STOPS 16
+
+/* largest plan solveExact() takes, 12 attractions between the entrances */
+#define MAX_EXACT_STOPS 14
+
+/* strategies a portfolio race runs at once, one thread each */
+#define MAX_STRATEGIES 5
+
+/* tours kept on a Pareto front */
+#define PARETO_ARCHIVE 32
+
+/* most tours a struct BestTours keeps */
+#define MAX_BEST 16
+
+/* points kept in a convergence trace */
+#define MAX_TRACE 256
+
+/* wait scenarios scored together, one per SIMD lane (8 x int32 = one AVX2
+   register). Scenario 0 is always WaitMatrix */
+#define SCENARIO_LANES 8
+
+/* how a tour's scenario totals are folded into one score */
+#define OBJECTIVE_EXPECTED 0
+#define OBJECTIVE_WORST 1
+#define OBJECTIVE_PERCENTILE 2
+
+struct Plan;
+
+/* the best cost shared by the strategies of a portfolio race (portfolio.c).
+   Only ever read and written with the __atomic builtins */
+struct Race {
+    int incumbent;          // shortest day any strategy has found
+    int over;               // 1 once the race is decided or out of time
+};
+
+/* evaluation loops specialized for one tour length, see kernels.c */
+struct Kernels {
+    int (*walkCost)(const int *walk, const int *tour);
+    void (*flip)(const int *tour, int *newTour, int a, int b);
+    int (*schedule)(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes);
+};
+
+/* everything a solver needs about one plan, copied out of the json once so the
+   search loops never touch cJSON. Matrices are row-major and indexed by the
+   row of the attraction in AttractionsToInclude, so a tour is an array of rows
+   with the entrance row at both ends */
+struct Plan {
+    int length;             // stops in a tour, entrance included at both ends
+    int numSlices;          // columns in the wait matrices
+    int segment;            // TimesliceLength in minutes
+    int startTime;          // Start, minutes since midnight
+    int stopTime;           // Stop or ParkClosesToGeneralPublic, whichever is first
+    int matrixStart;        // MatrixStartTime, time of wait column 0
+    int planId;             // PlanID
+
+    int *key;               // attraction label of each row
+    int *rideTime;          // RideMatrix by row
+    int *walk;              // length x length walking minutes, shortest over any stops
+    int *walkVia;           // a stop on each shortest walk, -1 if direct (closure.c)
+    int *waitTable;         // length x numSlices standby wait, averaged like calculateWait()
+    int *startTour;         // StartingArray as rows
+    int *priority;          // Priorities by row, value of visiting each attraction
+    double walkingWeight;   // WalkingWeight, 1 without it
+    double waitingWeight;   // WaitingWeight, 1 without it
+
+    // FastPass (return-time pass) data, filled in by loadFastPass()
+    int *returnTable;       // length x numSlices wait when arriving with a pass
+    int *passGroup;         // FPPGroups index of each row, -1 if the row can't take a pass
+    unsigned char *passFixed;   // 1 if the pass can't be dropped (ReservedFP / FPOnly)
+    int numGroups;
+    int groupLimit[MAX_PASS_GROUPS];    // FPPGroupLimits minus CompletedFP
+    int forcePasses;        // ForceFastpass
+
+    // wait scenarios, filled in by loadScenarios()
+    int numScenarios;       // WaitMatrix plus every other Wait...Matrix
+    int *scenarioTable;     // length x numSlices x SCENARIO_LANES, lanes innermost
+    double scenarioWeight[SCENARIO_LANES];  // probability of each scenario
+
+    const struct Kernels *kernels;  // for this length, NULL past MAX_KERNEL_STOPS
+
+    // room in the tables above, which reloadPlan() reuses for any plan that fits
+    int *scratchTable;      // 2 x length x numSlices, a matrix as read and averaged while loading
+    int rowCapacity;
+    int sliceCapacity;
+
+    // filled in by detectSymmetry()
+    int symmetricWalk;      // 1 if every tour walks as far as its reverse
+    int flatWaits;          // 1 if no standby wait changes during the day
+
+    int stopCost;           // solvers stop at a tour this short, 0 never (stopAtGap)
+    struct Race *race;      // portfolio race the solve is part of, NULL when alone
+    struct BestTours *alternatives; // solvers offer the tours they score here, NULL for none
+};
+
+/* every attraction of a park, loaded once, with an index from attraction
+   label to row so plans can be gathered from it (park.c) */
+struct Park {
+    struct Plan plan;       // a plan over every attraction, entrance at both ends
+    int numLabels;          // largest label + 1
+    int *rowOfLabel;        // row of each label in plan, -1 if not in the park
+};
+
+/* a tour replanned from the middle of the day by replanTour() */
+struct Replan {
+    int tour[MAX_ROWS];     // entrance, visited stops, current location, remaining stops, exit
+    int current;            // position of the guest's current location in tour
+    int offTimes[MAX_ROWS]; // timeline from current on, offTimes[current] is the current time
+    int finishTime;         // arrival back at the entrance
+};
+
+/* a tour that may skip attractions, built by the orienteering solver */
+struct Route {
+    int stops[MAX_ROWS];    // rows, entrance at both ends
+    int length;
+    int offTimes[MAX_ROWS]; // timeline, offTimes[length - 1] is the arrival back at the entrance
+    int value;              // total priority of the stops visited
+};
+
+/* wall-clock phase timers and hot-path counters for one plan */
+struct Metrics {
+    double phaseSeconds[NUM_PHASES];
+    double phaseStarted[NUM_PHASES];
+    long movesEvaluated;    // candidate moves scored by a solver
+    long movesAccepted;     // moves the solver kept
+    long improvements;      // new best tours
+    long cacheHits;         // candidate tours scored from the tour cache
+    double timeToBest;      // seconds into the solve phase the best tour was found
+    int lowerBound;         // floor on the day from bounds.c, 0 if not computed
+    int bestCost;           // total time of the best tour the solve returned
+};
+
+/* one per thread, so every strategy of a portfolio race counts its own */
+extern __thread struct Metrics planMetrics;
+
+/* best cost over time during an anytime solve, preallocated so recording a
+   point never allocates */
+struct Trace {
+    int length;
+    double seconds[MAX_TRACE];  // since the solve started
+    int cost[MAX_TRACE];
+};
+
+/* how one strategy of a portfolio race did, from its own planMetrics */
+struct StrategyStats {
+    const char *name;
+    int cost;               // total time of its best tour, -1 if it never ran
+    long movesEvaluated;
+    long movesAccepted;
+    long improvements;
+    double timeToBest;      // seconds into its run its best tour was found
+    double seconds;         // how long it ran before it stopped or was cancelled
+};
+
+/* the result of a portfolio race */
+struct Portfolio {
+    int numStrategies;
+    struct StrategyStats stats[MAX_STRATEGIES];
+    int winner;             // index of the strategy whose tour won
+    int proven;             // 1 if the winning tour is known to be optimal
+    int cost;               // total time of tour
+    int tour[MAX_ROWS];
+};
+
+/* non-dominated tours over (walking, waiting, total time), see pareto.c. One
+   slot more than the archive holds a newcomer until a member makes way */
+struct ParetoFront {
+    int size;
+    int walking[PARETO_ARCHIVE + 1];
+    int waiting[PARETO_ARCHIVE + 1];
+    int total[PARETO_ARCHIVE + 1];
+    int tours[PARETO_ARCHIVE + 1][MAX_ROWS];
+};
+
+/* the k shortest distinct days a solver has scored, see kbest.c. heap holds
+   slot numbers as a max-heap on (cost, hash), so heap[0] is the worst kept */
+struct BestTours {
+    int capacity;           // k, at most MAX_BEST
+    int size;
+    int length;             // stops in the tours
+    int heap[MAX_BEST];
+    signed char lookup[2 * MAX_BEST];   // slot + 1 of each kept tour, open-addressed by hash, 0 empty
+    int cost[MAX_BEST];     // by slot
+    unsigned long long hash[MAX_BEST];
+    int tours[MAX_BEST][MAX_ROWS];
+    int offTimes[MAX_BEST][MAX_ROWS];   // timeline of each tour, from sortBestTours()
+};
+
+/* finish times of a tour over sampled waits, see montecarlo.c. Times are
+   minutes since midnight, back at the entrance */
+struct Simulation {
+    int samples;
+    double meanFinish;
+    int p50, p90, p95, p99;
+    double overrun;         // share of samples back after the plan's stopTime
+};
+
+/* a file of solved plans mapped shared into every solver process, see
+   plancache.c */
+struct PlanCache {
+    int fd;
+    size_t size;                // bytes mapped
+    void *map;
+    unsigned int mask;          // entries - 1, entries is a power of two
+    struct CachedPlan *entries;
+};
+
+/* what a batch of plan files did, see pipeline.c. The stage times are busy
+   seconds summed over the threads of the stage */
+struct BatchStats {
+    int plans;                  // plans solved and written
+    int failed;                 // files that couldn't be read or loaded
+    double seconds;             // wall time of the whole batch
+    double loadSeconds;
+    double solveSeconds;
+    double writeSeconds;
+};
+
+/* one tour in the tour cache of tabu.c, hash 0 marks an empty slot */
+struct CacheEntry {
+    unsigned long long hash;    // zobrist hash of the tour
+    int cost;                   // total time of the tour
+    int tabuUntil;              // tabu search step the tour stays tabu through
+};
+
+/* fixed-size, open-addressed, lossy cache of tour costs */
+struct TourCache {
+    int length;                 // stops in the tours it holds
+    unsigned int mask;          // entries - 1, entries is a power of two
+    struct CacheEntry *entries;
+    unsigned long long *keys;   // length x length zobrist keys, [position][row]
+};
+
+/* one plan and the scratch space to solve, evaluate and schedule it, so the
+   library entry points in library.c never allocate once a plan is loaded */
+struct Planner {
+    struct Plan plan;
+    int loaded;                         // 1 once a plan is loaded
+    int tour[MAX_ROWS];                 // best tour so far, as rows
+    unsigned char usePass[MAX_ROWS];    // passes of the best tour, by row
+    int offTimes[MAX_ROWS];             // timeline of the best tour
+    int cost;                           // total time of the best tour
+    int bound;                          // lower bound on the day, from bounds.c
+    struct Trace trace;                 // convergence of the last timed solve
+    struct PlanCache *cache;            // solved plans shared between processes, NULL for none
+    int fromCache;                      // 1 if the last solve was answered by the cache
+    int scratchTour[MAX_ROWS];          // tour being evaluated
+    unsigned char scratchPass[MAX_ROWS];
+    int scratchTimes[MAX_ROWS];
+};
+
+/* hashing and random bits shared by the modules. They sit in the inner
+   loops of the tour cache, the memetic search and the simulation, so they
+   are inline here rather than in plan.c */
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+// folds count ints into an FNV-1a hash, start from FNV_OFFSET
+static inline unsigned long long fnvInts(unsigned long long hash, const int *values, int count) {
+    for (int i = 0; i < count; i++) {
+        hash = (hash ^ (unsigned int)values[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// steps a xorshift64 state, which must not be 0, and returns it
+static inline unsigned long long xorshift64(unsigned long long *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// the splitmix64 finalizer, 64 well mixed bits from any 64
+static inline unsigned long long mix64(unsigned long long x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// source.c
 long getSize(char *filename);
 int getMax(int *arr, int length);
 void printMatrix(int rows, int cols, int distanceMatrix[MAX_ROWS][MAX_COLS]);
@@ -23,5 +321,154 @@ int calculateSegments(int startMinutes, int currentMinutes, int segment);
 void printArray(const int arr[], int size);
 int calculateWait(int matrix[MAX_ROWS][MAX_COLS], int index, int segments);
 
+// plan.c
+cJSON* readPlanFile(char *filename);
+int parseLabel(const cJSON *item);
+int findRow(const struct Plan *plan, int label);
+void labelsToTour(const struct Plan *plan, const int *labels, int *tour);
+void tourToLabels(const struct Plan *plan, const int *tour, int *labels);
+int readMatrix(const cJSON *data, int rows, int cols, int *out, const char *name);
+void buildWaitTable(const int *matrix, int rows, int slices, int *table);
+void detectSymmetry(struct Plan *plan);
+void allocPlan(struct Plan *plan, int n, int slices);
+int loadPlan(const cJSON *json, struct Plan *plan);
+int reloadPlan(const cJSON *json, struct Plan *plan);
+void freePlan(struct Plan *plan);
+int tableAt(const struct Plan *plan, const int *table, int row, int time);
+int rescheduleRoute(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, int *offTimes, int from);
+int rescheduleFrom(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes, int from);
+int scheduleTour(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes);
+int walkingCost(const struct Plan *plan, const int *tour, int length);
+int suffixCost(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom);
+int evaluateRouteSuffix(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom);
+int evaluateSuffix(const struct Plan *plan, const int *tour, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom);
+void printSchedule(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass);
+
+// fastPass.c
+int loadFastPass(const cJSON *json, struct Plan *plan);
+void initPasses(const struct Plan *plan, const int *tour, unsigned char *usePass, int *groupUsed);
+int optimizeWithPasses(const struct Plan *plan, int *tour, unsigned char *usePass, int maxLoops);
+int optimizeUntil(const struct Plan *plan, int *tour, unsigned char *usePass, int deadlineMs, struct Trace *trace);
+
+// scenarios.c
+void setScenario(struct Plan *plan, const int *table, int lane);
+int loadScenarios(const cJSON *json, struct Plan *plan);
+void scheduleScenarios(const struct Plan *plan, const int *tour, const unsigned char *usePass, int offLanes[][SCENARIO_LANES], int from);
+double scenarioScore(const struct Plan *plan, const int *totals, int objective, int percentile);
+double evaluateScenarios(const struct Plan *plan, const int *tour, const unsigned char *usePass, int objective, int percentile, int *totals);
+double optimizeRobust(const struct Plan *plan, int *tour, const unsigned char *usePass, int objective, int percentile, int maxLoops);
+
+// replan.c
+void updateWaits(struct Plan *plan, const int *waitMatrix);
+int replanTour(const struct Plan *plan, const int *previousTour, const unsigned char *visited, int currentRow, int currentTime, const unsigned char *usePass, int maxMoves, struct Replan *result);
+
+// orienteering.c
+int insertionFinish(const struct Plan *plan, const struct Route *route, int p, int row);
+int removalFinish(const struct Plan *plan, const struct Route *route, int p);
+void insertStop(const struct Plan *plan, struct Route *route, int p, int row);
+void removeStop(const struct Plan *plan, struct Route *route, int p);
+void greedyFill(const struct Plan *plan, struct Route *route);
+void shortenRoute(const struct Plan *plan, struct Route *route);
+int solveOrienteering(const struct Plan *plan, int maxLoops, struct Route *best);
+
+// synthetic.c
+void generatePark(struct Plan *plan, int n, unsigned int seed);
+
+// closure.c
+int closeWalks(const int *walk, int n, int *dist, int *via);
+int closePlanWalks(struct Plan *plan);
+int walkPath(const struct Plan *plan, int from, int to, int *stops);
+
+// park.c
+int indexPark(struct Park *park);
+int loadPark(const cJSON *json, struct Park *park);
+int gatherPlan(const struct Park *park, const int *labels, int k, int startTime, int stopTime, struct Plan *plan);
+void freePark(struct Park *park);
+
+// exact.c
+int solveExact(const struct Plan *plan, const unsigned char *usePass, int *tour);
+
+// bounds.c
+int assignmentBound(const int *walk, int n);
+int oneTreeBound(const int *walk, int n, int upper);
+int walkingBound(const int *walk, int n, int upper);
+int dayBound(const struct Plan *plan, int usePasses, int upper);
+double optimalityGap(int cost, int bound);
+void stopAtGap(struct Plan *plan, int bound, double percent);
+
+// library.c
+void plannerInit(struct Planner *ctx);
+int plannerLoad(struct Planner *ctx, const char *text);
+int plannerLoadFile(struct Planner *ctx, char *filename);
+int plannerLoadFromPark(struct Planner *ctx, const struct Park *park, const int *labels, int count, int startTime, int stopTime);
+int plannerUseCache(struct Planner *ctx, struct PlanCache *cache);
+int plannerSolve(struct Planner *ctx, int deadlineMs, int maxLoops);
+int plannerStopGap(struct Planner *ctx, double percent);
+int plannerEvaluate(struct Planner *ctx, const int *labels, const unsigned char *passes);
+int plannerSchedule(const struct Planner *ctx, int *labels, int *offTimes, unsigned char *passes);
+void plannerFree(struct Planner *ctx);
+
+// kernels.c
+const struct Kernels* selectKernels(int n);
+void flipTour(const struct Plan *plan, const int *tour, int *newTour, int a, int b);
+
+// tabu.c
+void initTourCache(struct TourCache *cache, const struct Plan *plan, int bits);
+void freeTourCache(struct TourCache *cache);
+unsigned long long hashTour(const struct TourCache *cache, const int *tour);
+unsigned long long hashReversal(const struct TourCache *cache, const int *tour, unsigned long long hash, int lo, int hi);
+struct CacheEntry* findTour(struct TourCache *cache, unsigned long long hash);
+struct CacheEntry* storeTour(struct TourCache *cache, unsigned long long hash, int cost);
+int optimizeTabu(const struct Plan *plan, int *tour, const unsigned char *usePass, int maxSteps, struct TourCache *cache);
+
+// vnd.c
+int optimizeVnd(const struct Plan *plan, int *tour, const unsigned char *usePass);
+
+// memetic.c
+int optimizeMemetic(const struct Plan *plan, int *tour, int generations, int threads, unsigned int seed);
+
+// pareto.c
+int scoreObjectives(const struct Plan *plan, const int *tour, int *walking, int *waiting);
+int solvePareto(const struct Plan *plan, struct ParetoFront *front, int maxMoves);
+int preferredTour(const struct Plan *plan, const struct ParetoFront *front);
+
+// kbest.c
+int initBestTours(struct BestTours *best, int k);
+int bestToursLimit(const struct BestTours *best);
+int offerBestTour(struct BestTours *best, const int *tour, int n, int cost);
+int mergeBestTours(struct BestTours *best, const struct BestTours *from);
+void sortBestTours(const struct Plan *plan, struct BestTours *best, const unsigned char *usePass);
+
+// montecarlo.c
+int simulateTours(const struct Plan *plan, const int *tours, int count, const unsigned char *usePass, int samples, int threads, unsigned int seed, struct Simulation *results);
+int rerankTours(const struct Plan *plan, const struct BestTours *best, int samples, int threads, unsigned int seed, int percent, struct Simulation *results, int *order);
+
+// plancache.c
+unsigned long long planFingerprint(const struct Plan *plan, const char *solver);
+int openPlanCache(struct PlanCache *cache, const char *path, int bits);
+void closePlanCache(struct PlanCache *cache);
+int lookupPlan(const struct PlanCache *cache, unsigned long long fingerprint, int *labels, unsigned char *passes);
+int storePlan(struct PlanCache *cache, unsigned long long fingerprint, const int *labels, const unsigned char *passes, int length, int cost);
+int restoreTour(const struct Plan *plan, const int *labels, const unsigned char *passes, int cost, int *tour, unsigned char *usePass);
+
+// pipeline.c
+int runBatch(char **files, int count, int loaders, int solvers, int loopsPerStop, FILE *out, struct BatchStats *stats);
+
+// portfolio.c
+int keepSearching(const struct Plan *plan, int cost);
+int raceIncumbent(const struct Plan *plan, int cost);
+int solvePortfolio(const struct Plan *plan, int deadlineMs, struct Portfolio *result);
+
+// metrics.c
+double wallClock();
+void resetMetrics();
+void startPhase(int phase);
+void endPhase(int phase);
+void noteImprovement();
+void printMetricsJson(FILE *fp, int planId);
+void printMetricsPrometheus(FILE *fp, int planId);
+void addTrace(struct Trace *trace, double seconds, int cost);
+void printTraceJson(FILE *fp, const struct Trace *trace);
+
 
-#endif // FUNCTIONS_H
\ No newline at end of file
+#endif // FUNCTIONS_H
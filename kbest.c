@@ -0,0 +1,236 @@
+// kbest.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* entries of the hash table over the kept tours, a power of two */
+#define LOOKUP_SIZE (2 * MAX_BEST)
+
+/*............................................................................*/
+
+/* Best Tours Functions:
+	1. ranksAfter -> whether one kept tour ranks after another
+	2. siftUp / siftDown -> restore the heap after a slot changed
+	3. findKept / addLookup / removeLookup -> the hash table that finds a
+	   kept tour by its hash
+	4. initBestTours -> an empty set of the k best tours
+	5. bestToursLimit -> the longest day a tour can take and still go in
+	6. offerBestTour -> keeps a tour if it is among the k best seen
+	7. mergeBestTours -> offers every tour of one set to another
+	8. sortBestTours -> orders a set shortest day first and fills in the
+	   timeline of each tour
+
+   A guest who doesn't like the best tour wants the next few, and the
+   solvers score thousands of tours they then forget. A struct BestTours
+   keeps the k shortest distinct days a solver has scored. The tours sit in
+   fixed slots and the heap is an array of slot numbers ordered as a
+   max-heap on (cost, hash), so the worst kept tour is always heap[0] and a
+   change moves ints, never tours. A candidate that isn't shorter than that
+   worst tour is turned away after one comparison, which is almost every
+   candidate once the set is full. One that gets in replaces the worst
+   tour and is sifted down in O(log k).
+
+   Solvers revisit tours, so a tour goes in only once: candidates that
+   would get in are hashed (FNV-1a) and looked up in lookup, an
+   open-addressed table of the kept slots by hash that is never more than
+   half full, so finding a duplicate takes a probe or two and only a tour
+   with the same hash is compared in full. Admission stays O(log k). Ties on cost are broken by the
+   hash, so the k best of any set of tours are the same whatever order
+   they are offered in. That is what lets each thread fill its own set and
+   the sets be merged afterwards with the same result as one shared set. */
+
+
+// true when the tour of cost and hash ranks after the one in slot
+static bool ranksAfter(const struct BestTours *best, int cost, unsigned long long hash, int slot) {
+	return cost > best->cost[slot] || (cost == best->cost[slot] && hash > best->hash[slot]);
+}
+
+// moves heap[i] up while it ranks after its parent
+static void siftUp(struct BestTours *best, int i) {
+	int slot = best->heap[i];
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (!ranksAfter(best, best->cost[slot], best->hash[slot], best->heap[parent])) {
+			break;
+		}
+		best->heap[i] = best->heap[parent];
+		i = parent;
+	}
+	best->heap[i] = slot;
+}
+
+// moves heap[i] down while a child ranks after it
+static void siftDown(struct BestTours *best, int i) {
+	int slot = best->heap[i];
+	while (2 * i + 1 < best->size) {
+		int child = 2 * i + 1;
+		if (child + 1 < best->size && ranksAfter(best, best->cost[best->heap[child + 1]], best->hash[best->heap[child + 1]], best->heap[child])) {
+			child++;
+		}
+		if (!ranksAfter(best, best->cost[best->heap[child]], best->hash[best->heap[child]], slot)) {
+			break;
+		}
+		best->heap[i] = best->heap[child];
+		i = child;
+	}
+	best->heap[i] = slot;
+}
+
+// the first lookup entry a tour of this hash probes
+static int lookupHome(unsigned long long hash) {
+	return (int)(hash & (LOOKUP_SIZE - 1));
+}
+
+// the kept slot holding this tour, RESULT_ERROR if it isn't kept
+static int findKept(const struct BestTours *best, const int *tour, int n, unsigned long long hash) {
+	for (int i = lookupHome(hash); best->lookup[i] != 0; i = (i + 1) & (LOOKUP_SIZE - 1)) {
+		int slot = best->lookup[i] - 1;
+		if (best->hash[slot] == hash && memcmp(best->tours[slot], tour, n * sizeof(int)) == 0) {
+			return slot;
+		}
+	}
+	return RESULT_ERROR;
+}
+
+// enters a kept slot in the lookup table under its hash
+static void addLookup(struct BestTours *best, int slot) {
+	int i = lookupHome(best->hash[slot]);
+	while (best->lookup[i] != 0) {
+		i = (i + 1) & (LOOKUP_SIZE - 1);
+	}
+	best->lookup[i] = (signed char)(slot + 1);
+}
+
+/* takes a slot out of the lookup table, moving later entries of the probe
+   run back so no lookup stops early at the hole */
+static void removeLookup(struct BestTours *best, int slot) {
+	int i = lookupHome(best->hash[slot]);
+	while (best->lookup[i] != slot + 1) {
+		i = (i + 1) & (LOOKUP_SIZE - 1);
+	}
+	for (int j = (i + 1) & (LOOKUP_SIZE - 1); best->lookup[j] != 0; j = (j + 1) & (LOOKUP_SIZE - 1)) {
+		int home = lookupHome(best->hash[best->lookup[j] - 1]);
+		// the entry at j may fill the hole at i unless its home lies after i, up to j
+		bool between = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+		if (!between) {
+			best->lookup[i] = best->lookup[j];
+			i = j;
+		}
+	}
+	best->lookup[i] = 0;
+}
+
+/* empties best and sets it to keep the k shortest days, at most MAX_BEST.
+   Returns 0, or RESULT_ERROR if k is out of range */
+int initBestTours(struct BestTours *best, int k) {
+	best->capacity = 0;
+	best->size = 0;
+	best->length = 0;
+	memset(best->lookup, 0, sizeof(best->lookup));
+	if (k < 1 || k > MAX_BEST) {
+		printf("Error: can keep between 1 and %d best tours, not %d.\n", MAX_BEST, k);
+		return RESULT_ERROR;
+	}
+	best->capacity = k;
+	return 0;
+}
+
+/* the longest day a tour can take and still be kept, INT_MAX while the set
+   isn't full. A search can drop anything that must end after it */
+int bestToursLimit(const struct BestTours *best) {
+	return best->size < best->capacity ? INT_MAX : best->cost[best->heap[0]];
+}
+
+/* keeps the n-stop tour, which takes cost minutes, if it is one of the k
+   best distinct tours offered so far, dropping the worst kept tour when
+   the set is full. Returns 1 if the tour was kept */
+int offerBestTour(struct BestTours *best, const int *tour, int n, int cost) {
+	bool full = best->size == best->capacity;
+	if (full && cost > best->cost[best->heap[0]]) {
+		return 0;
+	}
+
+	unsigned long long hash = fnvInts(FNV_OFFSET, tour, n);
+	if (full && cost == best->cost[best->heap[0]] && hash >= best->hash[best->heap[0]]) {
+		return 0;
+	}
+	if (findKept(best, tour, n, hash) >= 0) {
+		return 0;
+	}
+
+	best->length = n;
+	if (!full) {
+		int slot = best->size++;
+		best->cost[slot] = cost;
+		best->hash[slot] = hash;
+		memcpy(best->tours[slot], tour, n * sizeof(int));
+		addLookup(best, slot);
+		best->heap[slot] = slot;
+		siftUp(best, slot);
+		return 1;
+	}
+
+	int slot = best->heap[0];
+	removeLookup(best, slot);
+	best->cost[slot] = cost;
+	best->hash[slot] = hash;
+	memcpy(best->tours[slot], tour, n * sizeof(int));
+	addLookup(best, slot);
+	siftDown(best, 0);
+	return 1;
+}
+
+/* offers every tour of from to best, so best ends with the k best distinct
+   tours of the two. Returns how many of from's tours were kept */
+int mergeBestTours(struct BestTours *best, const struct BestTours *from) {
+	int kept = 0;
+	for (int i = 0; i < from->size; i++) {
+		kept += offerBestTour(best, from->tours[i], from->length, from->cost[i]);
+	}
+	return kept;
+}
+
+/* moves the kept tours into slots 0..size - 1, shortest day first, and
+   fills in offTimes of each from scheduleTour() with the passes in usePass
+   (NULL for standby only). The set stays a valid heap and can take more
+   tours afterwards */
+void sortBestTours(const struct Plan *plan, struct BestTours *best, const unsigned char *usePass) {
+	int order[MAX_BEST], cost[MAX_BEST];
+	unsigned long long hash[MAX_BEST];
+	int tours[MAX_BEST][MAX_ROWS];
+	int n = best->length;
+
+	// insertion sort of the slots, the way the heap ranks them
+	for (int i = 0; i < best->size; i++) {
+		int slot = best->heap[i];
+		int j = i;
+		for (; j > 0 && ranksAfter(best, best->cost[order[j - 1]], best->hash[order[j - 1]], slot); j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = slot;
+	}
+
+	for (int i = 0; i < best->size; i++) {
+		cost[i] = best->cost[order[i]];
+		hash[i] = best->hash[order[i]];
+		memcpy(tours[i], best->tours[order[i]], n * sizeof(int));
+	}
+	memset(best->lookup, 0, sizeof(best->lookup));
+	for (int i = 0; i < best->size; i++) {
+		best->cost[i] = cost[i];
+		best->hash[i] = hash[i];
+		memcpy(best->tours[i], tours[i], n * sizeof(int));
+		addLookup(best, i);
+		scheduleTour(plan, best->tours[i], usePass, best->offTimes[i]);
+		// descending order is a max-heap
+		best->heap[i] = best->size - 1 - i;
+	}
+}
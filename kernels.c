@@ -0,0 +1,116 @@
+// kernels.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* Kernel Functions:
+	1. walkCostN -> walking minutes of a full tour of exactly N stops
+	2. flipN -> copy of a tour of N stops with one segment reversed
+	3. scheduleN -> whole timeline of a tour of N stops, scheduleTour()
+	4. selectKernels -> picks the kernels for a plan's length when it loads
+	5. flipTour -> flip() for a plan's tours, through its kernel if it has one
+
+   Most plans have 8 to 16 stops, and the exhaustive and multi-start modes
+   run these billions of times. Each kernel is stamped out by a macro for
+   one tour length N, so the cost and schedule loops have a constant trip
+   count the compiler unrolls completely and the matrix stride is a
+   constant. The flip kernel copies the whole tour with one fixed-size
+   memcpy (a few vector moves) and then swaps the segment ends inward,
+   which measured faster than three copy loops or a per-element select.
+   Plans longer than MAX_KERNEL_STOPS get no kernels and use the generic
+   loops. */
+
+
+/* times are clamped to two days past the wait matrix start, which keeps the
+   unsigned reciprocal slice division below exact (same as scenarios.c) */
+#define MAX_OFFSET 2880
+
+/* the wait table column for a time of day, tableAt() without the row and
+   with the division by the segment done as a multiply by its reciprocal */
+static int sliceAt(int time, int matrixStart, unsigned int reciprocal, int lastSlice) {
+	int offset = time - matrixStart;
+	offset = offset < 0 ? 0 : offset;
+	offset = offset > MAX_OFFSET ? MAX_OFFSET : offset;
+	int s = ((unsigned int)offset * reciprocal) >> 20;
+	return s > lastSlice ? lastSlice : s;
+}
+
+#define KERNELS(N) \
+static int walkCost##N(const int *walk, const int *tour) { \
+	int cost = 0; \
+	for (int i = 0; i < N - 1; i++) { \
+		cost += walk[tour[i] * N + tour[i + 1]]; \
+	} \
+	return cost; \
+} \
+\
+static void flip##N(const int *tour, int *newTour, int a, int b) { \
+	int lo = a < b ? a : b; \
+	int hi = a < b ? b : a; \
+	memcpy(newTour, tour, N * sizeof(int)); \
+	for (int i = lo, j = hi; i < j; i++, j--) { \
+		newTour[i] = tour[j]; \
+		newTour[j] = tour[i]; \
+	} \
+} \
+\
+static int schedule##N(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes) { \
+	const int *walk = plan->walk; \
+	int slices = plan->numSlices; \
+	unsigned int reciprocal = (1u << 20) / plan->segment + 1; \
+	int off_time = plan->startTime; \
+	offTimes[0] = off_time; \
+	for (int i = 1; i < N - 1; i++) { \
+		int row = tour[i]; \
+		int arrival_time = off_time + walk[tour[i - 1] * N + row]; \
+		const int *table = (usePass != NULL && usePass[row]) ? plan->returnTable : plan->waitTable; \
+		off_time = arrival_time + table[row * slices + sliceAt(arrival_time, plan->matrixStart, reciprocal, slices - 1)] + plan->rideTime[row]; \
+		offTimes[i] = off_time; \
+	} \
+	offTimes[N - 1] = off_time + walk[tour[N - 2] * N + tour[N - 1]]; \
+	return offTimes[N - 1] - offTimes[0]; \
+} \
+\
+static const struct Kernels kernels##N = {walkCost##N, flip##N, schedule##N};
+
+KERNELS(3)
+KERNELS(4)
+KERNELS(5)
+KERNELS(6)
+KERNELS(7)
+KERNELS(8)
+KERNELS(9)
+KERNELS(10)
+KERNELS(11)
+KERNELS(12)
+KERNELS(13)
+KERNELS(14)
+KERNELS(15)
+KERNELS(16)
+
+// kernels for each tour length, indexed by the number of stops
+static const struct Kernels *kernelsByLength[MAX_KERNEL_STOPS + 1] = {
+	NULL, NULL, NULL, &kernels3, &kernels4, &kernels5, &kernels6, &kernels7, &kernels8,
+	&kernels9, &kernels10, &kernels11, &kernels12, &kernels13, &kernels14, &kernels15, &kernels16
+};
+
+// the kernels for a plan of n stops, NULL if the generic loops have to be used
+const struct Kernels* selectKernels(int n) {
+	if (n < 3 || n > MAX_KERNEL_STOPS) {
+		return NULL;
+	}
+	return kernelsByLength[n];
+}
+
+// flip() for a full length tour of the plan, through its kernel if it has one
+void flipTour(const struct Plan *plan, const int *tour, int *newTour, int a, int b) {
+	if (plan->kernels != NULL) {
+		plan->kernels->flip(tour, newTour, a, b);
+	} else {
+		flip((int*)tour, newTour, a, b, plan->length);
+	}
+}
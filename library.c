@@ -0,0 +1,290 @@
+// library.c
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/*............................................................................*/
+
+/* Library Functions:
+	1. plannerInit -> readies a context before its first plan
+	2. plannerLoad -> loads a plan from json text already in memory
+	3. plannerLoadFile -> loads a plan from a json file
+	4. plannerLoadFromPark -> builds a plan from a preloaded park, without
+	   json
+	5. plannerUseCache -> answers the solves of a context from a solved-plan
+	   cache when it can
+	6. plannerSolve -> optimizes visit order and passes, to a deadline or a
+	   fixed number of moves
+	7. plannerStopGap -> lets the solves stop once they are provably close
+	   to optimal
+	8. plannerEvaluate -> total time of a tour given as attraction labels
+	9. plannerSchedule -> the best tour as labels with its timeline
+	10. plannerFree -> frees the plan held by a context
+
+   These are the entry points for calling the planner in-process, built into
+   libplanner.a with the rest of the plan modules. A struct Planner holds one
+   plan plus every array a solve, evaluation or schedule needs, so once a
+   plan is loaded nothing on the request path allocates, and one context can
+   be reused for request after request: plannerLoad and plannerLoadFile load
+   into the tables of the plan before, which only grow when a plan is larger
+   than any the context has held. A server loads its park once
+   (loadPark) and builds each request's plan from it with
+   plannerLoadFromPark, which skips json entirely. With a plan cache a
+   request someone already sent is answered from the cache file without
+   solving, and every solve leaves its tour there for the next one.
+   Contexts share nothing but the cache, and planMetrics is per thread, but
+   the solvers draw from rand(), so runs are only repeatable with one
+   thread per process. */
+
+
+// readies a context before its first plan
+void plannerInit(struct Planner *ctx) {
+	memset(ctx, 0, sizeof(struct Planner));
+}
+
+/* starts the best tour of a freshly loaded plan at its starting tour with
+   the decided passes, and bounds the day */
+static void readyContext(struct Planner *ctx) {
+	int groupUsed[MAX_PASS_GROUPS];
+	memcpy(ctx->tour, ctx->plan.startTour, ctx->plan.length * sizeof(int));
+	initPasses(&ctx->plan, ctx->tour, ctx->usePass, groupUsed);
+	ctx->cost = scheduleTour(&ctx->plan, ctx->tour, ctx->usePass, ctx->offTimes);
+	ctx->bound = dayBound(&ctx->plan, 1, ctx->cost);
+	ctx->trace.length = 0;
+	ctx->loaded = 1;
+}
+
+/* loads parsed plan json into a context, in the tables its last plan
+   left. The best tour starts as StartingArray with the decided passes, and
+   ctx->bound gets the lower bound on the day that the gap of every solve
+   is measured against */
+static int loadContext(struct Planner *ctx, const cJSON *json) {
+	if (reloadPlan(json, &ctx->plan) != 0) {
+		return RESULT_ERROR;
+	}
+	readyContext(ctx);
+	return 0;
+}
+
+/* loads a plan from json text already in memory, replacing the plan the
+   context held. Returns 0, or RESULT_ERROR after printing what was wrong.
+   Safe to call on several contexts at once: a parse error is found from
+   the end pointer of this parse, not cJSON's global error pointer */
+int plannerLoad(struct Planner *ctx, const char *text) {
+	const char *end = NULL;
+	ctx->loaded = 0;
+
+	cJSON *json = cJSON_ParseWithOpts(text, &end, 0);
+	if (json == NULL) {
+		printf("Error: plan json is invalid at byte %ld.\n", end != NULL ? (long)(end - text) : 0L);
+		return RESULT_ERROR;
+	}
+
+	int result = loadContext(ctx, json);
+	cJSON_Delete(json);
+	return result;
+}
+
+// loads a plan from a json file, RESULT_ERROR if it can't be read or loaded
+int plannerLoadFile(struct Planner *ctx, char *filename) {
+	ctx->loaded = 0;
+
+	cJSON *json = readPlanFile(filename);
+	if (json == NULL) {
+		return RESULT_ERROR;
+	}
+
+	int result = loadContext(ctx, json);
+	cJSON_Delete(json);
+	return result;
+}
+
+/* builds the context's plan over the attractions in labels (entrance at
+   both ends, in starting tour order) from a park loaded by loadPark, for a
+   day from startTime to stopTime, replacing the plan it held. Returns 0,
+   or RESULT_ERROR if a label isn't in the park or the list isn't the
+   entrance, distinct attractions and the entrance again */
+int plannerLoadFromPark(struct Planner *ctx, const struct Park *park, const int *labels, int count, int startTime, int stopTime) {
+	plannerFree(ctx);
+
+	if (gatherPlan(park, labels, count, startTime, stopTime, &ctx->plan) != 0) {
+		return RESULT_ERROR;
+	}
+	readyContext(ctx);
+	return 0;
+}
+
+/* makes the context's solves look in cache first and store what they find
+   there, NULL turns it off. The cache stays open and owned by the caller,
+   and may be shared by any number of contexts. Returns 0 */
+int plannerUseCache(struct Planner *ctx, struct PlanCache *cache) {
+	ctx->cache = cache;
+	return 0;
+}
+
+/* optimizes the visit order and passes of the loaded plan, continuing from
+   the best tour so far. With deadlineMs > 0 it runs until the deadline and
+   ctx->trace gets the convergence trace, otherwise it makes maxLoops moves.
+   With a cache, a cached tour shorter than the best so far is taken
+   without solving (ctx->fromCache is set), and a solved tour is stored.
+   Returns the total time of the best tour, at most optimalityGap(cost,
+   ctx->bound) percent over optimal, or RESULT_ERROR with no plan */
+int plannerSolve(struct Planner *ctx, int deadlineMs, int maxLoops) {
+	int n = ctx->plan.length;
+	unsigned long long fingerprint = 0;
+
+	if (!ctx->loaded) {
+		printf("Error: no plan loaded.\n");
+		return RESULT_ERROR;
+	}
+
+	ctx->fromCache = 0;
+	if (ctx->cache != NULL) {
+		fingerprint = planFingerprint(&ctx->plan, "fastpass");
+		int cost = lookupPlan(ctx->cache, fingerprint, ctx->scratchTimes, ctx->scratchPass);
+		if (cost >= 0 && cost < ctx->cost
+			&& restoreTour(&ctx->plan, ctx->scratchTimes, ctx->scratchPass, cost, ctx->scratchTour, ctx->usePass) == cost) {
+			memcpy(ctx->tour, ctx->scratchTour, n * sizeof(int));
+			ctx->cost = scheduleTour(&ctx->plan, ctx->tour, ctx->usePass, ctx->offTimes);
+			ctx->fromCache = 1;
+			return ctx->cost;
+		}
+	}
+
+	if (deadlineMs > 0) {
+		ctx->cost = optimizeUntil(&ctx->plan, ctx->tour, ctx->usePass, deadlineMs, &ctx->trace);
+	} else {
+		ctx->trace.length = 0;
+		ctx->cost = optimizeWithPasses(&ctx->plan, ctx->tour, ctx->usePass, maxLoops);
+	}
+	scheduleTour(&ctx->plan, ctx->tour, ctx->usePass, ctx->offTimes);
+
+	if (ctx->cache != NULL) {
+		tourToLabels(&ctx->plan, ctx->tour, ctx->scratchTimes);
+		for (int i = 0; i < n; i++) {
+			ctx->scratchPass[i] = ctx->usePass[ctx->tour[i]];
+		}
+		storePlan(ctx->cache, fingerprint, ctx->scratchTimes, ctx->scratchPass, n, ctx->cost);
+	}
+	return ctx->cost;
+}
+
+/* makes the following solves stop as soon as the best tour is within
+   percent of ctx->bound, which proves it is at most that far from optimal.
+   A negative percent turns it off. Returns RESULT_ERROR with no plan */
+int plannerStopGap(struct Planner *ctx, double percent) {
+	if (!ctx->loaded) {
+		printf("Error: no plan loaded.\n");
+		return RESULT_ERROR;
+	}
+
+	stopAtGap(&ctx->plan, ctx->bound, percent);
+	return 0;
+}
+
+/* total time of a tour given as attraction labels, entrance at both ends.
+   The stops in between must be every other attraction of the plan once
+   each, in any order. passes flags the positions that ride with a pass, or
+   is NULL for only the passes already decided (ReservedFP, FPOnly). Returns
+   RESULT_ERROR if a label isn't in the plan, the tour repeats or leaves
+   out an attraction or passes the entrance, or the passes are ones the
+   plan can't give: a pass where no FPPGroup offers one, more passes from a
+   group than FPPGroupLimits allows, or a decided pass left out */
+int plannerEvaluate(struct Planner *ctx, const int *labels, const unsigned char *passes) {
+	const struct Plan *plan = &ctx->plan;
+	int n = plan->length;
+	unsigned char seen[MAX_ROWS] = {0};
+	int groupUsed[MAX_PASS_GROUPS] = {0};
+
+	if (!ctx->loaded) {
+		printf("Error: no plan loaded.\n");
+		return RESULT_ERROR;
+	}
+
+	labelsToTour(plan, labels, ctx->scratchTour);
+	memset(ctx->scratchPass, 0, n * sizeof(unsigned char));
+	for (int i = 1; i < n - 1; i++) {
+		int row = ctx->scratchTour[i];
+		if (row < 0) {
+			printf("Error: attraction %d is not in the plan.\n", labels[i]);
+			return RESULT_ERROR;
+		}
+		// n - 2 distinct rows between 1 and n - 2 are all of them
+		if (row == 0 || row >= n - 1 || seen[row]) {
+			printf("Error: stop %d (attraction %d) repeats an attraction or the entrance.\n", i, labels[i]);
+			return RESULT_ERROR;
+		}
+		seen[row] = 1;
+
+		// decided passes count against their group first, as in initPasses()
+		bool pass = passes != NULL ? passes[i] != 0 : plan->passFixed[row] != 0;
+		if (plan->passFixed[row] && !pass) {
+			printf("Error: attraction %d has a pass already decided.\n", labels[i]);
+			return RESULT_ERROR;
+		}
+		if (plan->passFixed[row] && plan->passGroup[row] >= 0) {
+			groupUsed[plan->passGroup[row]]++;
+		}
+		ctx->scratchPass[row] = pass;
+	}
+
+	for (int i = 1; i < n - 1; i++) {
+		int row = ctx->scratchTour[i];
+		int g = plan->passGroup[row];
+		if (!ctx->scratchPass[row] || plan->passFixed[row]) {
+			continue;
+		}
+		if (g < 0) {
+			printf("Error: attraction %d can't take a pass.\n", labels[i]);
+			return RESULT_ERROR;
+		}
+		if (groupUsed[g] >= plan->groupLimit[g]) {
+			printf("Error: pass group %d allows only %d passes.\n", g, plan->groupLimit[g]);
+			return RESULT_ERROR;
+		}
+		groupUsed[g]++;
+	}
+
+	return scheduleTour(&ctx->plan, ctx->scratchTour, ctx->scratchPass, ctx->scratchTimes);
+}
+
+/* the best tour as attraction labels, with offTimes[i] the time the guest
+   gets off stop i (the last entry is the arrival back at the entrance) and
+   passes[i] set where stop i rides with a pass. Any output may be NULL.
+   Returns the number of stops, RESULT_ERROR with no plan */
+int plannerSchedule(const struct Planner *ctx, int *labels, int *offTimes, unsigned char *passes) {
+	int n = ctx->plan.length;
+
+	if (!ctx->loaded) {
+		printf("Error: no plan loaded.\n");
+		return RESULT_ERROR;
+	}
+
+	if (labels != NULL) {
+		tourToLabels(&ctx->plan, ctx->tour, labels);
+	}
+	if (offTimes != NULL) {
+		memcpy(offTimes, ctx->offTimes, n * sizeof(int));
+	}
+	if (passes != NULL) {
+		for (int i = 0; i < n; i++) {
+			passes[i] = ctx->usePass[ctx->tour[i]];
+		}
+	}
+	return n;
+}
+
+/* frees the plan held by a context and the tables kept for the next one.
+   The context can then load another */
+void plannerFree(struct Planner *ctx) {
+	freePlan(&ctx->plan);
+	ctx->loaded = 0;
+}
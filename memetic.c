@@ -0,0 +1,404 @@
+// memetic.c
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* tours kept from one generation to the next, and children bred per
+   generation */
+#define POPULATION 32
+
+/* random moves each child is polished with, per stop of the plan */
+#define POLISH_MOVES_PER_STOP 20
+
+/* most worker threads a solve starts */
+#define MAX_THREADS 16
+
+/*............................................................................*/
+
+/* Memetic Functions:
+	1. seedStream -> the random stream of one child in one generation
+	2. crossover -> order crossover (OX) of two parent tours
+	3. polish -> improving-move local search on a child, scored with
+	   suffixCost()
+	4. breed -> makes and scores one child of the next generation
+	5. workerLoop -> what each thread of the pool runs
+	6. optimizeMemetic -> the memetic search over a plan's visit order
+
+   Large "see everything" plans have too many orders for one search
+   trajectory, and the local searches stall in their first deep local
+   optimum. The memetic search keeps a population of good tours. Each
+   generation breeds POPULATION children: two parents picked by tournament
+   are combined by order crossover, which copies a slice of one parent and
+   fills the rest in the order the other visits them, and the child is
+   polished by random reversals and or-opt moves that are kept when they
+   shorten the day. The best POPULATION distinct tours of parents and
+   children go on. The entrance stays at both ends throughout.
+
+   Children are bred in parallel by a pool of threads that lives for the
+   whole solve and meets the main thread at two barriers per generation.
+   Every buffer is allocated before the pool starts, each child writes only
+   its own slot, and the workers only read the plan and call functions that
+   touch nothing global, counting their moves per thread. Each child draws
+   from its own stream seeded by (seed, generation, child), so a solve gives
+   the same tour however many threads run it.
+
+   With plan->alternatives set every polished child is also offered to a
+   struct BestTours of its worker's own, so the workers never share one,
+   and those are merged into plan->alternatives when the solve ends. The k
+   best of the merged sets are the k best children overall, so they too
+   don't depend on the number of threads. */
+
+
+// one tour of the population with its total time
+struct Individual {
+	int cost;
+	int tour[MAX_ROWS];
+};
+
+// everything the pool shares, written by the main thread between generations
+struct Memetic {
+	const struct Plan *plan;
+	struct Individual *parents;     // POPULATION tours, best first
+	struct Individual *children;    // POPULATION children being bred
+	struct Individual *next;        // the next generation while it is picked
+	int generation;
+	unsigned long long seed;
+	int numThreads;                 // workers in the pool, 0 breeds on the calling thread
+	bool stop;
+	pthread_mutex_t ready;          // held until the barriers are set up
+	pthread_barrier_t start;
+	pthread_barrier_t done;
+	long evaluated[MAX_THREADS];    // moves scored by each worker
+	long accepted[MAX_THREADS];
+	struct BestTours *kept;         // best children of each worker, NULL without plan->alternatives
+};
+
+// a worker thread and its pool
+struct Worker {
+	struct Memetic *memetic;
+	int id;
+};
+
+// splitmix64 step, used to seed the streams
+static unsigned long long mixSeed(unsigned long long x) {
+	return mix64(x + GOLDEN_GAMMA);
+}
+
+// the random stream of one child in one generation, never zero
+static unsigned long long seedStream(unsigned long long seed, int generation, int child) {
+	unsigned long long state = mixSeed(seed ^ mixSeed(((unsigned long long)generation << 32) | (unsigned int)child));
+	return state != 0 ? state : 1;
+}
+
+// a random number in 0..bound - 1 (xorshift)
+static int nextInt(unsigned long long *state, int bound) {
+	return (int)((xorshift64(state) >> 11) % (unsigned long long)bound);
+}
+
+/* order crossover: the child gets a random slice of the first parent at the
+   same positions and the other attractions in the order the second parent
+   visits them, starting after the slice. The entrance stays at both ends */
+static void crossover(const int *first, const int *second, int *child, int n, unsigned long long *state) {
+	int m = n - 2;
+	unsigned char used[MAX_ROWS] = {0};
+	int i = 1 + nextInt(state, m);
+	int j = 1 + nextInt(state, m);
+	if (i > j) {
+		int t = i;
+		i = j;
+		j = t;
+	}
+
+	child[0] = first[0];
+	child[n - 1] = first[n - 1];
+	for (int k = i; k <= j; k++) {
+		child[k] = first[k];
+		used[first[k]] = 1;
+	}
+
+	// positions after the slice then round to before it, second parent from the same place
+	int pos = j % m + 1;
+	for (int k = 0; k < m; k++) {
+		int row = second[(j + k) % m + 1];
+		if (!used[row]) {
+			child[pos] = row;
+			pos = pos % m + 1;
+		}
+	}
+}
+
+/* makes "moves" random moves on the tour, each a segment reversal or an
+   or-opt move of 1 to 3 stops, and keeps the ones that shorten the day.
+   Returns the total time */
+static int polish(const struct Plan *plan, int *tour, int moves, unsigned long long *state, long *evaluated, long *accepted) {
+	int n = plan->length;
+	int m = n - 2;
+	int offTimes[MAX_ROWS], trialTimes[MAX_ROWS], trial[MAX_ROWS];
+	int cost = scheduleTour(plan, tour, NULL, offTimes);
+
+	if (m < 2) {
+		return cost;
+	}
+
+	for (int k = 0; k < moves; k++) {
+		int lo, hi;
+		memcpy(trial, tour, n * sizeof(int));
+
+		if (nextInt(state, 2) == 0) {
+			// reverse trial[lo..hi]
+			int p1 = 1 + nextInt(state, m);
+			int p2 = 1 + nextInt(state, m);
+			if (p1 == p2) {
+				continue;
+			}
+			lo = p1 < p2 ? p1 : p2;
+			hi = p1 < p2 ? p2 : p1;
+			flipTour(plan, tour, trial, lo, hi);
+		} else {
+			// move the run tour[a..b] so it starts at position "to"
+			int len = 1 + nextInt(state, m < 3 ? m - 1 : 3);
+			int a = 1 + nextInt(state, m - len + 1);
+			int to = 1 + nextInt(state, m - len + 1);
+			if (to == a) {
+				continue;
+			}
+			int run[3];
+			memcpy(run, tour + a, len * sizeof(int));
+			if (to < a) {
+				memmove(trial + to + len, tour + to, (a - to) * sizeof(int));
+				lo = to;
+				hi = a + len - 1;
+			} else {
+				memmove(trial + a, tour + a + len, (to - a) * sizeof(int));
+				lo = a;
+				hi = to + len - 1;
+			}
+			memcpy(trial + to, run, len * sizeof(int));
+		}
+
+		(*evaluated)++;
+		int new_cost = suffixCost(plan, trial, n, NULL, offTimes, trialTimes, lo, hi + 1);
+		if (new_cost < cost) {
+			memcpy(tour + lo, trial + lo, (hi - lo + 1) * sizeof(int));
+			rescheduleFrom(plan, tour, NULL, offTimes, lo);
+			cost = new_cost;
+			(*accepted)++;
+		}
+	}
+	return cost;
+}
+
+// the better of two random parents
+static const struct Individual* tournament(const struct Individual *parents, unsigned long long *state) {
+	const struct Individual *a = &parents[nextInt(state, POPULATION)];
+	const struct Individual *b = &parents[nextInt(state, POPULATION)];
+	return a->cost <= b->cost ? a : b;
+}
+
+/* makes and scores child i of the current generation. Generation 0 starts
+   from StartingArray (child 0) and shuffles of it, the others cross two
+   parents over */
+static void breed(struct Memetic *memetic, int i, int worker) {
+	const struct Plan *plan = memetic->plan;
+	int n = plan->length;
+	struct Individual *child = &memetic->children[i];
+	unsigned long long state = seedStream(memetic->seed, memetic->generation, i);
+
+	if (memetic->generation == 0) {
+		memcpy(child->tour, plan->startTour, n * sizeof(int));
+		for (int k = n - 2; k > 1 && i > 0; k--) {
+			int j = 1 + nextInt(&state, k);
+			int t = child->tour[k];
+			child->tour[k] = child->tour[j];
+			child->tour[j] = t;
+		}
+	} else {
+		const struct Individual *first = tournament(memetic->parents, &state);
+		const struct Individual *second = tournament(memetic->parents, &state);
+		crossover(first->tour, second->tour, child->tour, n, &state);
+	}
+
+	// counted locally so the workers don't share a cache line per move
+	long evaluated = 0, accepted = 0;
+	child->cost = polish(plan, child->tour, POLISH_MOVES_PER_STOP * n, &state, &evaluated, &accepted);
+	memetic->evaluated[worker] += evaluated;
+	memetic->accepted[worker] += accepted;
+	if (memetic->kept != NULL) {
+		offerBestTour(&memetic->kept[worker], child->tour, n, child->cost);
+	}
+}
+
+// what each thread of the pool runs: its share of every generation's children
+static void* workerLoop(void *arg) {
+	struct Worker *worker = (struct Worker*)arg;
+	struct Memetic *memetic = worker->memetic;
+
+	// the barriers are sized once every thread has started
+	pthread_mutex_lock(&memetic->ready);
+	pthread_mutex_unlock(&memetic->ready);
+
+	while (true) {
+		pthread_barrier_wait(&memetic->start);
+		if (memetic->stop) {
+			break;
+		}
+		for (int i = worker->id; i < POPULATION; i += memetic->numThreads) {
+			breed(memetic, i, worker->id);
+		}
+		pthread_barrier_wait(&memetic->done);
+	}
+	return NULL;
+}
+
+// breeds every child of the current generation, on the pool if there is one
+static void runGeneration(struct Memetic *memetic) {
+	if (memetic->numThreads == 0) {
+		for (int i = 0; i < POPULATION; i++) {
+			breed(memetic, i, 0);
+		}
+		return;
+	}
+	pthread_barrier_wait(&memetic->start);
+	pthread_barrier_wait(&memetic->done);
+}
+
+// for qsort, shortest day first
+static int compareIndividuals(const void *a, const void *b) {
+	const struct Individual *x = *(const struct Individual* const*)a;
+	const struct Individual *y = *(const struct Individual* const*)b;
+	return x->cost - y->cost;
+}
+
+/* the best POPULATION tours of parents and children become the parents, each
+   tour kept once while there are enough distinct ones */
+static void nextGeneration(struct Memetic *memetic, bool withParents) {
+	int n = memetic->plan->length;
+	const struct Individual *pool[2 * POPULATION];
+	unsigned char taken[2 * POPULATION] = {0};
+	int count = 0, kept = 0;
+
+	for (int i = 0; i < POPULATION; i++) {
+		pool[count++] = &memetic->children[i];
+		if (withParents) {
+			pool[count++] = &memetic->parents[i];
+		}
+	}
+	qsort(pool, count, sizeof(pool[0]), compareIndividuals);
+
+	for (int pass = 0; pass < 2 && kept < POPULATION; pass++) {
+		for (int i = 0; i < count && kept < POPULATION; i++) {
+			if (taken[i]) {
+				continue;
+			}
+			bool copy = kept > 0 && pool[i]->cost == memetic->next[kept - 1].cost
+				&& memcmp(pool[i]->tour, memetic->next[kept - 1].tour, n * sizeof(int)) == 0;
+			if (copy && pass == 0) {
+				continue;
+			}
+			memetic->next[kept++] = *pool[i];
+			taken[i] = 1;
+		}
+	}
+
+	struct Individual *old = memetic->parents;
+	memetic->parents = memetic->next;
+	memetic->next = old;
+}
+
+/* memetic search over the visit order with standby waits, "generations"
+   generations bred on "threads" threads (0 for one per core). tour gets the
+   best tour found, or the first within plan->stopCost. The same seed gives
+   the same tour for any number of threads, and if no thread can be started
+   the children are bred on the calling thread. Every child is offered to
+   plan->alternatives when that is set. Returns its total time */
+int optimizeMemetic(const struct Plan *plan, int *tour, int generations, int threads, unsigned int seed) {
+	struct Memetic memetic;
+	struct Worker workers[MAX_THREADS];
+	pthread_t ids[MAX_THREADS];
+
+	if (threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+
+	memset(&memetic, 0, sizeof(struct Memetic));
+	memetic.plan = plan;
+	memetic.seed = seed;
+	struct Individual *buffers = (struct Individual*)malloc(3 * POPULATION * sizeof(struct Individual));
+	memetic.parents = buffers;
+	memetic.children = buffers + POPULATION;
+	memetic.next = buffers + 2 * POPULATION;
+	if (plan->alternatives != NULL) {
+		memetic.kept = (struct BestTours*)malloc(threads * sizeof(struct BestTours));
+		for (int t = 0; t < threads; t++) {
+			initBestTours(&memetic.kept[t], plan->alternatives->capacity);
+		}
+	}
+
+	// workers wait on "ready" until the barriers know how many of them started
+	pthread_mutex_init(&memetic.ready, NULL);
+	pthread_mutex_lock(&memetic.ready);
+	for (int t = 0; t < threads; t++) {
+		workers[t].memetic = &memetic;
+		workers[t].id = t;
+		if (pthread_create(&ids[t], NULL, workerLoop, &workers[t]) != 0) {
+			printf("Warning: started %d of %d threads.\n", t, threads);
+			break;
+		}
+		memetic.numThreads++;
+	}
+	if (memetic.numThreads > 0) {
+		pthread_barrier_init(&memetic.start, NULL, memetic.numThreads + 1);
+		pthread_barrier_init(&memetic.done, NULL, memetic.numThreads + 1);
+	}
+	pthread_mutex_unlock(&memetic.ready);
+
+	int best = 0;
+	for (int g = 0; g <= generations; g++) {
+		memetic.generation = g;
+		runGeneration(&memetic);
+		nextGeneration(&memetic, g > 0);
+
+		if (g == 0 || memetic.parents[0].cost < best) {
+			best = memetic.parents[0].cost;
+			noteImprovement();
+		}
+		if (!keepSearching(plan, best)) {
+			break;
+		}
+	}
+
+	if (memetic.numThreads > 0) {
+		memetic.stop = true;
+		pthread_barrier_wait(&memetic.start);
+		for (int t = 0; t < memetic.numThreads; t++) {
+			pthread_join(ids[t], NULL);
+		}
+		pthread_barrier_destroy(&memetic.start);
+		pthread_barrier_destroy(&memetic.done);
+	}
+	pthread_mutex_destroy(&memetic.ready);
+
+	for (int t = 0; t < MAX_THREADS; t++) {
+		planMetrics.movesEvaluated += memetic.evaluated[t];
+		planMetrics.movesAccepted += memetic.accepted[t];
+	}
+	if (memetic.kept != NULL) {
+		for (int t = 0; t < threads; t++) {
+			mergeBestTours(plan->alternatives, &memetic.kept[t]);
+		}
+		free(memetic.kept);
+	}
+	memcpy(tour, memetic.parents[0].tour, plan->length * sizeof(int));
+	free(buffers);
+	return best;
+}
@@ -0,0 +1,115 @@
+// metrics.c
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* Metrics Functions:
+	1. wallClock -> seconds on the monotonic clock
+	2. resetMetrics -> zeroes every timer and counter before a plan
+	3. startPhase -> starts timing one phase of a plan
+	4. endPhase -> adds the time since startPhase to the phase
+	5. noteImprovement -> counts a new best tour and records time-to-best
+	6. printMetricsJson -> writes the metrics of a plan as one json object
+	7. printMetricsPrometheus -> writes them in prometheus text format
+	8. addTrace -> appends one (time, cost) point to a convergence trace
+	9. printTraceJson -> writes a convergence trace as a json array
+
+   The solvers bump the counters in planMetrics directly, which is one add
+   on a global per move, and only read the clock when they find a new best
+   tour, so the counters stay on in production. The callers fill in the
+   lower bound and best cost, and the gap between them is printed with the
+   counters. planMetrics is thread-local: the strategies of a portfolio race
+   each count into their own copy, and solvePortfolio() adds them up. */
+
+
+__thread struct Metrics planMetrics;
+
+static const char *phaseNames[NUM_PHASES] = {"read", "parse", "matrix", "solve", "schedule", "output"};
+
+// seconds on the monotonic clock, unaffected by changes to the time of day
+double wallClock() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// zeroes every timer and counter before a plan
+void resetMetrics() {
+	memset(&planMetrics, 0, sizeof(struct Metrics));
+}
+
+// starts timing one phase of a plan
+void startPhase(int phase) {
+	planMetrics.phaseStarted[phase] = wallClock();
+}
+
+// adds the time since startPhase to the phase, phases can run more than once
+void endPhase(int phase) {
+	planMetrics.phaseSeconds[phase] += wallClock() - planMetrics.phaseStarted[phase];
+}
+
+// counts a new best tour and records how far into the solve it was found
+void noteImprovement() {
+	planMetrics.improvements++;
+	planMetrics.timeToBest = wallClock() - planMetrics.phaseStarted[PHASE_SOLVE];
+}
+
+// writes the metrics of a plan as one json object
+void printMetricsJson(FILE *fp, int planId) {
+	fprintf(fp, "{\"planId\":%d,\"phases\":{", planId);
+	for (int p = 0; p < NUM_PHASES; p++) {
+		fprintf(fp, "\"%s\":%.6f%s", phaseNames[p], planMetrics.phaseSeconds[p], p < NUM_PHASES - 1 ? "," : "");
+	}
+	fprintf(fp, "},\"movesEvaluated\":%ld,\"movesAccepted\":%ld,\"improvements\":%ld,\"cacheHits\":%ld,\"timeToBest\":%.6f",
+		planMetrics.movesEvaluated, planMetrics.movesAccepted, planMetrics.improvements, planMetrics.cacheHits, planMetrics.timeToBest);
+	fprintf(fp, ",\"lowerBound\":%d,\"bestCost\":%d,\"gap\":%.3f}\n",
+		planMetrics.lowerBound, planMetrics.bestCost, optimalityGap(planMetrics.bestCost, planMetrics.lowerBound));
+}
+
+// writes the metrics of a plan in prometheus text format
+void printMetricsPrometheus(FILE *fp, int planId) {
+	fprintf(fp, "# TYPE planner_phase_seconds gauge\n");
+	for (int p = 0; p < NUM_PHASES; p++) {
+		fprintf(fp, "planner_phase_seconds{plan=\"%d\",phase=\"%s\"} %.6f\n", planId, phaseNames[p], planMetrics.phaseSeconds[p]);
+	}
+	fprintf(fp, "# TYPE planner_moves_evaluated_total counter\n");
+	fprintf(fp, "planner_moves_evaluated_total{plan=\"%d\"} %ld\n", planId, planMetrics.movesEvaluated);
+	fprintf(fp, "# TYPE planner_moves_accepted_total counter\n");
+	fprintf(fp, "planner_moves_accepted_total{plan=\"%d\"} %ld\n", planId, planMetrics.movesAccepted);
+	fprintf(fp, "# TYPE planner_improvements_total counter\n");
+	fprintf(fp, "planner_improvements_total{plan=\"%d\"} %ld\n", planId, planMetrics.improvements);
+	fprintf(fp, "# TYPE planner_cache_hits_total counter\n");
+	fprintf(fp, "planner_cache_hits_total{plan=\"%d\"} %ld\n", planId, planMetrics.cacheHits);
+	fprintf(fp, "# TYPE planner_time_to_best_seconds gauge\n");
+	fprintf(fp, "planner_time_to_best_seconds{plan=\"%d\"} %.6f\n", planId, planMetrics.timeToBest);
+	fprintf(fp, "# TYPE planner_lower_bound_minutes gauge\n");
+	fprintf(fp, "planner_lower_bound_minutes{plan=\"%d\"} %d\n", planId, planMetrics.lowerBound);
+	fprintf(fp, "# TYPE planner_best_cost_minutes gauge\n");
+	fprintf(fp, "planner_best_cost_minutes{plan=\"%d\"} %d\n", planId, planMetrics.bestCost);
+	fprintf(fp, "# TYPE planner_optimality_gap_percent gauge\n");
+	fprintf(fp, "planner_optimality_gap_percent{plan=\"%d\"} %.3f\n", planId, optimalityGap(planMetrics.bestCost, planMetrics.lowerBound));
+}
+
+/* appends one (time, cost) point to a convergence trace. The buffer is never
+   grown: once it is full the last point is overwritten, so it always ends
+   with the best cost found */
+void addTrace(struct Trace *trace, double seconds, int cost) {
+	int i = trace->length < MAX_TRACE ? trace->length++ : MAX_TRACE - 1;
+	trace->seconds[i] = seconds;
+	trace->cost[i] = cost;
+}
+
+// writes a convergence trace as a json array of [milliseconds, cost] pairs
+void printTraceJson(FILE *fp, const struct Trace *trace) {
+	fprintf(fp, "[");
+	for (int i = 0; i < trace->length; i++) {
+		fprintf(fp, "[%.3f,%d]%s", trace->seconds[i] * 1000, trace->cost[i], i < trace->length - 1 ? "," : "");
+	}
+	fprintf(fp, "]\n");
+}
@@ -0,0 +1,308 @@
+// montecarlo.c
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* timelines simulated side by side, one per lane like scheduleScenarios() */
+#define SIM_LANES 8
+
+/* spread of the waits, in percent of the mean, for plans with WaitMatrix only */
+#define DEFAULT_SPREAD_PERCENT 25
+
+/* most worker threads a simulation starts */
+#define MAX_THREADS 16
+
+/* same clamp as scenarios.c, keeps the reciprocal slice division exact */
+#define MAX_OFFSET 2880
+
+/*............................................................................*/
+
+/* Monte Carlo Functions:
+	1. buildSpread -> the spread of every averaged wait slice, from how far
+	   the wait scenarios are from WaitMatrix
+	2. mixCounter -> the random bits of one (seed, sample, row) counter
+	3. simulateLanes -> SIM_LANES timelines of one tour at once with sampled
+	   waits
+	4. simulateRange -> what each thread runs: its samples of every tour
+	5. summarize -> percentile finish times and the overrun probability of
+	   one tour's samples
+	6. simulateTours -> thousands of sampled timelines of each of a few
+	   tours, on every core
+	7. finishAt -> one of the percentile finish times of a simulation
+	8. rerankTours -> orders the kept best tours by a percentile of their
+	   simulated finish
+
+   calculateWait() takes the averaged WaitMatrix slice as certain, so a
+   tour that fits the day on paper can still run past park close. Here the
+   wait at each (row, slice) is a random variable centred on the averaged
+   WaitMatrix value. Its spread is the probability weighted root mean
+   square distance of the WaitXXXMatrix scenarios from WaitMatrix at that
+   slice, or DEFAULT_SPREAD_PERCENT of the mean when the plan has no other
+   scenario. A sample is the mean plus the spread times the sum of four
+   uniform draws rescaled to mean 0 and variance 1 (close to normal, bounded
+   at about 3.5 spreads), rounded and never below zero.
+
+   The random numbers are counter based: the draw for a stop is a hash of
+   (seed, sample, row), so any sample can be made on any thread in any
+   order and a simulation gives the same answer however many threads run
+   it. Keying on the row rather than the position also means sample s sees
+   the same wait at an attraction in every tour (common random numbers),
+   so differences between tours aren't drowned in sampling noise when they
+   are ranked. Timelines are simulated SIM_LANES at a time with the lanes
+   innermost and no division or branch in the lane loop, the same layout
+   as scheduleScenarios(), so the compiler vectorizes it. */
+
+
+// the samples a thread simulates and where it writes their finish times
+struct SimWork {
+	const struct Plan *plan;
+	const int *tours;           // count tours, MAX_ROWS apart
+	int count;
+	const unsigned char *usePass;
+	const float *spread;        // n x numSlices
+	unsigned long long key;
+	int samples;                // per tour, a multiple of SIM_LANES
+	int first, last;            // [first, last) samples of this thread
+	int *finish;                // count x samples, clock minutes back at the entrance
+};
+
+/* the spread of every averaged wait slice: the weighted root mean square
+   distance of the other scenarios from WaitMatrix, or DEFAULT_SPREAD_PERCENT
+   of the wait without them */
+static void buildSpread(const struct Plan *plan, float *spread) {
+	int cells = plan->length * plan->numSlices;
+	for (int c = 0; c < cells; c++) {
+		float mean = (float)plan->waitTable[c];
+		if (plan->numScenarios < 2) {
+			spread[c] = mean * DEFAULT_SPREAD_PERCENT / 100.0f;
+			continue;
+		}
+		const int *lanes = plan->scenarioTable + c * SCENARIO_LANES;
+		double square = 0;
+		for (int k = 0; k < plan->numScenarios; k++) {
+			double d = lanes[k] - mean;
+			square += plan->scenarioWeight[k] * d * d;
+		}
+		spread[c] = (float)sqrt(square);
+	}
+}
+
+// splitmix64 finalizer of a counter, 64 random bits per (key, counter)
+static inline unsigned long long mixCounter(unsigned long long key, unsigned long long counter) {
+	return mix64(key + counter * GOLDEN_GAMMA);
+}
+
+/* simulates samples sample..sample + SIM_LANES - 1 of a tour, lane k is
+   sample + k. finish gets the time each lane is back at the entrance */
+static void simulateLanes(const struct SimWork *work, const int *tour, int sample, int *finish) {
+	const struct Plan *plan = work->plan;
+	int n = plan->length;
+	int slices = plan->numSlices;
+	int lastSlice = slices - 1;
+	int matrixStart = plan->matrixStart;
+	unsigned int reciprocal = (1u << 20) / plan->segment + 1;
+	// four 16 bit uniforms sum to mean 2 x 65535 and variance 4 x 65536^2 / 12
+	const float scale = 1.7320508f / 65536.0f;
+
+	int off[SIM_LANES];
+	for (int k = 0; k < SIM_LANES; k++) {
+		off[k] = plan->startTime;
+	}
+
+	for (int i = 1; i < n - 1; i++) {
+		int row = tour[i];
+		int walk = plan->walk[tour[i - 1] * n + row];
+		int ride = plan->rideTime[row];
+
+		if (work->usePass != NULL && work->usePass[row]) {
+			// the return window of a pass is taken as certain
+			for (int k = 0; k < SIM_LANES; k++) {
+				int arrival = off[k] + walk;
+				off[k] = arrival + tableAt(plan, plan->returnTable, row, arrival) + ride;
+			}
+			continue;
+		}
+
+		const int *means = plan->waitTable + row * slices;
+		const float *spreads = work->spread + row * slices;
+		for (int k = 0; k < SIM_LANES; k++) {
+			int arrival = off[k] + walk;
+			int offset = arrival - matrixStart;
+			offset = offset < 0 ? 0 : offset;
+			offset = offset > MAX_OFFSET ? MAX_OFFSET : offset;
+			int s = ((unsigned int)offset * reciprocal) >> 20;
+			s = s > lastSlice ? lastSlice : s;
+
+			unsigned long long bits = mixCounter(work->key, ((unsigned long long)(sample + k) << 32) | (unsigned int)row);
+			int sum = (int)(bits & 0xFFFF) + (int)((bits >> 16) & 0xFFFF) + (int)((bits >> 32) & 0xFFFF) + (int)(bits >> 48);
+			float z = (sum - 2 * 65535) * scale;
+			float wait = means[s] + spreads[s] * z + 0.5f;
+			wait = wait < 0 ? 0 : wait;
+			off[k] = arrival + (int)wait + ride;
+		}
+	}
+
+	int walk = plan->walk[tour[n - 2] * n + tour[n - 1]];
+	for (int k = 0; k < SIM_LANES; k++) {
+		finish[k] = off[k] + walk;
+	}
+}
+
+// simulates samples [first, last) of every tour
+static void* simulateRange(void *arg) {
+	struct SimWork *work = (struct SimWork*)arg;
+	for (int t = 0; t < work->count; t++) {
+		const int *tour = work->tours + t * MAX_ROWS;
+		int *finish = work->finish + (size_t)t * work->samples;
+		for (int sample = work->first; sample < work->last; sample += SIM_LANES) {
+			simulateLanes(work, tour, sample, finish + sample);
+		}
+	}
+	return NULL;
+}
+
+// for qsort, earliest first
+static int compareMinutes(const void *a, const void *b) {
+	return *(const int*)a - *(const int*)b;
+}
+
+// the finish time at or under which "percent" % of the sorted samples are back
+static int percentileOf(const int *sorted, int samples, int percent) {
+	int index = (int)(((long)samples * percent + 99) / 100) - 1;
+	return sorted[index < 0 ? 0 : index];
+}
+
+// sorts one tour's finish times and fills in its summary
+static void summarize(const struct Plan *plan, int *finish, int samples, struct Simulation *result) {
+	long total = 0;
+	int late = 0;
+
+	qsort(finish, samples, sizeof(int), compareMinutes);
+	for (int s = 0; s < samples; s++) {
+		total += finish[s];
+		late += finish[s] > plan->stopTime;
+	}
+
+	result->samples = samples;
+	result->meanFinish = (double)total / samples;
+	result->p50 = percentileOf(finish, samples, 50);
+	result->p90 = percentileOf(finish, samples, 90);
+	result->p95 = percentileOf(finish, samples, 95);
+	result->p99 = percentileOf(finish, samples, 99);
+	result->overrun = (double)late / samples;
+}
+
+/* simulates "samples" timelines (rounded up to a multiple of SIM_LANES) of
+   each of the count tours, which are MAX_ROWS ints apart, with sampled
+   standby waits and the passes in usePass (NULL for none). Runs on
+   "threads" threads, 0 for one per core. results[t] gets the finish time
+   percentiles of tour t and how likely it is to end after plan->stopTime.
+   The same seed gives the same results for any number of threads. Returns
+   0, or RESULT_ERROR if samples isn't positive */
+int simulateTours(const struct Plan *plan, const int *tours, int count, const unsigned char *usePass, int samples, int threads, unsigned int seed, struct Simulation *results) {
+	struct SimWork work[MAX_THREADS];
+	pthread_t ids[MAX_THREADS];
+
+	if (samples <= 0) {
+		printf("Error: a simulation needs at least one sample, not %d.\n", samples);
+		return RESULT_ERROR;
+	}
+	samples = (samples + SIM_LANES - 1) / SIM_LANES * SIM_LANES;
+
+	if (threads <= 0) {
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	threads = threads < 1 ? 1 : (threads > MAX_THREADS ? MAX_THREADS : threads);
+	int blocks = samples / SIM_LANES;
+	threads = threads > blocks ? blocks : threads;
+
+	float *spread = (float*)malloc(plan->length * plan->numSlices * sizeof(float));
+	int *finish = (int*)malloc((size_t)count * samples * sizeof(int));
+	buildSpread(plan, spread);
+
+	// whole blocks of lanes per thread, the first ones get one more
+	int first = 0;
+	for (int t = 0; t < threads; t++) {
+		int share = blocks / threads + (t < blocks % threads);
+		work[t].plan = plan;
+		work[t].tours = tours;
+		work[t].count = count;
+		work[t].usePass = usePass;
+		work[t].spread = spread;
+		work[t].key = mixCounter(seed, 0);
+		work[t].samples = samples;
+		work[t].first = first;
+		work[t].last = first + share * SIM_LANES;
+		work[t].finish = finish;
+		first = work[t].last;
+	}
+
+	// the calling thread runs share 0, and the share of any thread that won't start
+	int started = 1;
+	for (int t = 1; t < threads; t++) {
+		if (pthread_create(&ids[t], NULL, simulateRange, &work[t]) != 0) {
+			break;
+		}
+		started++;
+	}
+	simulateRange(&work[0]);
+	for (int t = started; t < threads; t++) {
+		simulateRange(&work[t]);
+	}
+	for (int t = 1; t < started; t++) {
+		pthread_join(ids[t], NULL);
+	}
+
+	for (int t = 0; t < count; t++) {
+		summarize(plan, finish + (size_t)t * samples, samples, &results[t]);
+	}
+	planMetrics.movesEvaluated += (long)count * samples;
+
+	free(spread);
+	free(finish);
+	return 0;
+}
+
+// the "percent" percentile finish time of a simulation, 50, 90, 95 or 99
+static int finishAt(const struct Simulation *result, int percent) {
+	return percent == 99 ? result->p99 : percent == 95 ? result->p95 : percent == 90 ? result->p90 : result->p50;
+}
+
+/* simulates every tour kept in best (standby waits only) and orders them
+   by their "percent" percentile finish time (50, 90, 95 or 99), then by
+   the mean. results[i] is the simulation of best->tours[i] and order lists
+   the slots of best, most robust first. Returns 0, or RESULT_ERROR */
+int rerankTours(const struct Plan *plan, const struct BestTours *best, int samples, int threads, unsigned int seed, int percent, struct Simulation *results, int *order) {
+	if (percent != 50 && percent != 90 && percent != 95 && percent != 99) {
+		printf("Error: tours can be ranked by the 50th, 90th, 95th or 99th percentile, not %d.\n", percent);
+		return RESULT_ERROR;
+	}
+	if (simulateTours(plan, &best->tours[0][0], best->size, NULL, samples, threads, seed, results) != 0) {
+		return RESULT_ERROR;
+	}
+
+	// insertion sort of at most MAX_BEST slots
+	for (int i = 0; i < best->size; i++) {
+		int key = finishAt(&results[i], percent);
+		int j = i;
+		while (j > 0 && (finishAt(&results[order[j - 1]], percent) > key
+			|| (finishAt(&results[order[j - 1]], percent) == key && results[order[j - 1]].meanFinish > results[i].meanFinish))) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+	return 0;
+}
@@ -0,0 +1,250 @@
+// orienteering.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* Orienteering Functions:
+	1. insertionFinish -> finish time of a route with one more stop inserted
+	2. removalFinish -> finish time of a route with one stop taken out
+	3. insertStop -> inserts a stop and updates the timeline
+	4. removeStop -> removes a stop and updates the timeline
+	5. greedyFill -> keeps inserting the stop with the best priority per added
+	   minute until nothing else fits before park close
+	6. shortenRoute -> segment reversals that make the route finish earlier,
+	   which frees time for more stops
+	7. solveOrienteering -> picks and orders the subset of attractions with
+	   the most total priority that is back at the entrance by park close
+
+   Insertions and removals are scored on the time-dependent timeline from the
+   changed position on and stop early once the new timeline meets the old
+   one again. Waits and walks are never negative, so a candidate is dropped
+   as soon as any stop of it ends after park close. */
+
+
+/* finish time of the route with "row" inserted before position p, or a time
+   past stopTime as soon as it can't fit */
+int insertionFinish(const struct Plan *plan, const struct Route *route, int p, int row) {
+	int n = plan->length;
+	const int *stops = route->stops;
+	const int *offTimes = route->offTimes;
+
+	planMetrics.movesEvaluated++;
+
+	int prev = row;
+	int arrival_time = offTimes[p - 1] + plan->walk[stops[p - 1] * n + row];
+	int off_time = arrival_time + tableAt(plan, plan->waitTable, row, arrival_time) + plan->rideTime[row];
+
+	for (int i = p; i < route->length - 1; i++) {
+		if (off_time > plan->stopTime) {
+			return off_time;
+		}
+
+		int r = stops[i];
+		arrival_time = off_time + plan->walk[prev * n + r];
+		off_time = arrival_time + tableAt(plan, plan->waitTable, r, arrival_time) + plan->rideTime[r];
+
+		// the old and new timelines met, the rest of the day is unchanged
+		if (off_time == offTimes[i]) {
+			return offTimes[route->length - 1];
+		}
+		prev = r;
+	}
+	return off_time + plan->walk[prev * n + stops[route->length - 1]];
+}
+
+// finish time of the route with the stop at position p taken out
+int removalFinish(const struct Plan *plan, const struct Route *route, int p) {
+	int n = plan->length;
+	const int *stops = route->stops;
+	const int *offTimes = route->offTimes;
+
+	int prev = stops[p - 1];
+	int off_time = offTimes[p - 1];
+
+	planMetrics.movesEvaluated++;
+
+	for (int i = p + 1; i < route->length - 1; i++) {
+		int r = stops[i];
+		int arrival_time = off_time + plan->walk[prev * n + r];
+		off_time = arrival_time + tableAt(plan, plan->waitTable, r, arrival_time) + plan->rideTime[r];
+
+		if (off_time == offTimes[i]) {
+			return offTimes[route->length - 1];
+		}
+		prev = r;
+	}
+	return off_time + plan->walk[prev * n + stops[route->length - 1]];
+}
+
+// inserts "row" before position p and updates the timeline from there
+void insertStop(const struct Plan *plan, struct Route *route, int p, int row) {
+	memmove(&route->stops[p + 1], &route->stops[p], (route->length - p) * sizeof(int));
+	route->stops[p] = row;
+	route->length++;
+	planMetrics.movesAccepted++;
+	route->value += plan->priority[row];
+	rescheduleRoute(plan, route->stops, route->length, NULL, route->offTimes, p);
+}
+
+// removes the stop at position p and updates the timeline from there
+void removeStop(const struct Plan *plan, struct Route *route, int p) {
+	route->value -= plan->priority[route->stops[p]];
+	memmove(&route->stops[p], &route->stops[p + 1], (route->length - p - 1) * sizeof(int));
+	route->length--;
+	rescheduleRoute(plan, route->stops, route->length, NULL, route->offTimes, p);
+}
+
+/* keeps inserting the stop with the best priority per added minute, at its
+   cheapest position, until nothing else fits before park close */
+void greedyFill(const struct Plan *plan, struct Route *route) {
+	int n = plan->length;
+	bool inRoute[MAX_ROWS] = {false};
+
+	for (int i = 0; i < route->length; i++) {
+		inRoute[route->stops[i]] = true;
+	}
+
+	while (route->length < n) {
+		int finish = route->offTimes[route->length - 1];
+		double best_ratio = 0;
+		int best_row = -1, best_p = -1;
+
+		for (int row = 1; row < n - 1; row++) {
+			if (inRoute[row] || plan->priority[row] <= 0) {
+				continue;
+			}
+			for (int p = 1; p < route->length; p++) {
+				int new_finish = insertionFinish(plan, route, p, row);
+				if (new_finish > plan->stopTime) {
+					continue;
+				}
+
+				int added = new_finish - finish;
+				double ratio = (double)plan->priority[row] / (added > 1 ? added : 1);
+				if (ratio > best_ratio) {
+					best_ratio = ratio;
+					best_row = row;
+					best_p = p;
+				}
+			}
+		}
+
+		if (best_row < 0) {
+			return;
+		}
+		insertStop(plan, route, best_p, best_row);
+		inRoute[best_row] = true;
+	}
+}
+
+/* first improvement segment reversals that make the route finish earlier,
+   which frees time for more stops */
+void shortenRoute(const struct Plan *plan, struct Route *route) {
+	int trialTimes[MAX_ROWS];
+	int *stops = route->stops;
+	int length = route->length;
+	int cost = route->offTimes[length - 1] - route->offTimes[0];
+	bool improved = true;
+
+	while (improved) {
+		improved = false;
+		for (int lo = 1; lo < length - 2; lo++) {
+			for (int hi = lo + 1; hi < length - 1; hi++) {
+				for (int a = lo, b = hi; a < b; a++, b--) {
+					swap(&stops[a], &stops[b]);
+				}
+				int new_cost = evaluateRouteSuffix(plan, stops, length, NULL, route->offTimes, trialTimes, lo, hi + 1);
+
+				if (new_cost < cost) {
+					cost = new_cost;
+					planMetrics.movesAccepted++;
+					rescheduleRoute(plan, stops, length, NULL, route->offTimes, lo);
+					improved = true;
+				} else {
+					for (int a = lo, b = hi; a < b; a++, b--) {
+						swap(&stops[a], &stops[b]);
+					}
+				}
+			}
+		}
+	}
+}
+
+// position of the stop that gives up the least priority per minute it saves
+static int cheapestRemoval(const struct Plan *plan, const struct Route *route) {
+	int finish = route->offTimes[route->length - 1];
+	double best_ratio = 0;
+	int best_p = 1;
+
+	for (int p = 1; p < route->length - 1; p++) {
+		int saved = finish - removalFinish(plan, route, p);
+		double ratio = (double)(saved > 1 ? saved : 1) / (plan->priority[route->stops[p]] + 1);
+		if (ratio > best_ratio) {
+			best_ratio = ratio;
+			best_p = p;
+		}
+	}
+	return best_p;
+}
+
+// true if route a collects more priority, or the same in less time
+static bool betterRoute(const struct Route *a, const struct Route *b) {
+	if (a->value != b->value) {
+		return a->value > b->value;
+	}
+	return a->offTimes[a->length - 1] < b->offTimes[b->length - 1];
+}
+
+/* picks and orders the subset of attractions with the most total priority
+   that is back at the entrance by park close. Starts from a greedy fill,
+   then each loop drops one to three stops from the best route (at random or
+   the one that saves the most time for its priority), shortens what is left
+   and refills it, keeping the result when it is better. Returns the total
+   priority of the best route */
+int solveOrienteering(const struct Plan *plan, int maxLoops, struct Route *best) {
+	int n = plan->length;
+	struct Route current;
+
+	best->stops[0] = 0;
+	best->stops[1] = n - 1;
+	best->length = 2;
+	best->value = 0;
+	best->offTimes[0] = plan->startTime;
+	rescheduleRoute(plan, best->stops, best->length, NULL, best->offTimes, 1);
+
+	if (best->offTimes[1] > plan->stopTime) {
+		return 0;
+	}
+
+	greedyFill(plan, best);
+	shortenRoute(plan, best);
+	greedyFill(plan, best);
+
+	while (maxLoops-- > 0 && best->length > 2) {
+		memcpy(&current, best, sizeof(struct Route));
+
+		int drops = 1 + rand() % 3;
+		for (int d = 0; d < drops && current.length > 2; d++) {
+			int p = 1 + rand() % (current.length - 2);
+			if (rand() % 2 == 0) {
+				p = cheapestRemoval(plan, &current);
+			}
+			removeStop(plan, &current, p);
+		}
+
+		shortenRoute(plan, &current);
+		greedyFill(plan, &current);
+
+		if (betterRoute(&current, best)) {
+			noteImprovement();
+			memcpy(best, &current, sizeof(struct Route));
+		}
+	}
+
+	return best->value;
+}
@@ -0,0 +1,230 @@
+// pareto.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* share of the moves that relocate one stop, the rest reverse a segment */
+#define RELOCATE_PERCENT 30
+
+/*............................................................................*/
+
+/* Pareto Functions:
+	1. scoreObjectives -> walking, waiting and total time of a tour in one
+	   pass over its timeline
+	2. dominates -> whether one point of the front is at least as good as
+	   another in every objective
+	3. mostCrowded -> the member of a full front closest to another one
+	4. offerTour -> adds a tour to the front unless a member dominates it
+	5. randomNeighbour -> a random reversal or relocation of a tour
+	6. solvePareto -> Pareto local search for the non-dominated tours
+	7. preferredTour -> the member of a front the plan's WalkingWeight and
+	   WaitingWeight like best
+
+   Guests choose between "fastest" and "least walking", and the answers
+   in between, so instead of one tour per weighting this keeps the whole
+   non-dominated set over (walking, waiting, total day length). The rides
+   of a tour are fixed, so the day is walking plus waiting plus a constant,
+   but it is kept as its own objective so the front can be read and
+   extended without that assumption.
+
+   The front is a bounded archive of PARETO_ARCHIVE tours with the
+   objectives in separate arrays, so checking a candidate against every
+   member is a short branch-free scan. A tour goes in when no member is at
+   least as good in all three objectives, the members it dominates go out,
+   and when the archive overflows the member nearest to another one (in
+   objectives scaled by the front's range) makes way, never the best tour
+   of an objective. The search starts from StartingArray and repeatedly
+   offers a random neighbour of a random member, each scored by one pass
+   over the timeline that sums the walks and waits as it goes. */
+
+
+/* walking and waiting minutes of a tour without passes, from one pass over
+   its timeline. Returns the total time */
+int scoreObjectives(const struct Plan *plan, const int *tour, int *walking, int *waiting) {
+	int n = plan->length;
+	int off_time = plan->startTime;
+	int walked = 0, waited = 0;
+
+	for (int i = 1; i < n - 1; i++) {
+		int row = tour[i];
+		int walk = plan->walk[tour[i - 1] * n + row];
+		int wait = tableAt(plan, plan->waitTable, row, off_time + walk);
+		walked += walk;
+		waited += wait;
+		off_time += walk + wait + plan->rideTime[row];
+	}
+	int walk = plan->walk[tour[n - 2] * n + tour[n - 1]];
+	walked += walk;
+	off_time += walk;
+
+	*walking = walked;
+	*waiting = waited;
+	return off_time - plan->startTime;
+}
+
+// true when member a of the front is no worse than point b in every objective
+static bool dominates(const struct ParetoFront *front, int a, int walking, int waiting, int total) {
+	return (front->walking[a] <= walking) & (front->waiting[a] <= waiting) & (front->total[a] <= total);
+}
+
+/* the member of an overfull front with the nearest neighbour, measured in
+   objectives scaled by the range of the front. The best member of each
+   objective is never picked */
+static int mostCrowded(const struct ParetoFront *front) {
+	const int *objectives[3] = {front->walking, front->waiting, front->total};
+	double scale[3];
+	bool extreme[PARETO_ARCHIVE + 1] = {false};
+
+	for (int o = 0; o < 3; o++) {
+		int lo = 0, hi = 0;
+		for (int a = 1; a < front->size; a++) {
+			if (objectives[o][a] < objectives[o][lo]) {
+				lo = a;
+			}
+			if (objectives[o][a] > objectives[o][hi]) {
+				hi = a;
+			}
+		}
+		extreme[lo] = true;
+		scale[o] = objectives[o][hi] > objectives[o][lo] ? 1.0 / (objectives[o][hi] - objectives[o][lo]) : 0;
+	}
+
+	int crowded = -1;
+	double nearest = 0;
+	for (int a = 0; a < front->size; a++) {
+		if (extreme[a]) {
+			continue;
+		}
+		for (int b = 0; b < front->size; b++) {
+			if (b == a) {
+				continue;
+			}
+			double distance = 0;
+			for (int o = 0; o < 3; o++) {
+				double d = (objectives[o][a] - objectives[o][b]) * scale[o];
+				distance += d * d;
+			}
+			if (crowded < 0 || distance < nearest) {
+				crowded = a;
+				nearest = distance;
+			}
+		}
+	}
+	return crowded;
+}
+
+// moves the last member of the front into slot a
+static void removeMember(struct ParetoFront *front, int a) {
+	int last = --front->size;
+	if (a != last) {
+		front->walking[a] = front->walking[last];
+		front->waiting[a] = front->waiting[last];
+		front->total[a] = front->total[last];
+		memcpy(front->tours[a], front->tours[last], MAX_ROWS * sizeof(int));
+	}
+}
+
+/* adds a tour to the front unless a member is at least as good in every
+   objective, dropping the members it dominates and, when the archive
+   overflows, the most crowded member. Returns true if the tour went in */
+static bool offerTour(struct ParetoFront *front, const int *tour, int n, int walking, int waiting, int total) {
+	bool dominated = false;
+	for (int a = 0; a < front->size; a++) {
+		dominated |= dominates(front, a, walking, waiting, total);
+	}
+	if (dominated) {
+		return false;
+	}
+
+	for (int a = front->size - 1; a >= 0; a--) {
+		if (walking <= front->walking[a] && waiting <= front->waiting[a] && total <= front->total[a]) {
+			removeMember(front, a);
+		}
+	}
+
+	int slot = front->size++;
+	front->walking[slot] = walking;
+	front->waiting[slot] = waiting;
+	front->total[slot] = total;
+	memcpy(front->tours[slot], tour, n * sizeof(int));
+
+	if (front->size > PARETO_ARCHIVE) {
+		int crowded = mostCrowded(front);
+		removeMember(front, crowded);
+		return crowded != slot;
+	}
+	return true;
+}
+
+// a random reversal or single-stop relocation of tour, written to trial
+static void randomNeighbour(const struct Plan *plan, const int *tour, int *trial) {
+	int n = plan->length;
+	int p1 = (rand() % (n - 2)) + 1;
+	int p2 = p1;
+	while (p2 == p1) {
+		p2 = (rand() % (n - 2)) + 1;
+	}
+
+	if (rand() % 100 < RELOCATE_PERCENT) {
+		// the stop at p1 moves to position p2, the ones between close up
+		memcpy(trial, tour, n * sizeof(int));
+		int row = trial[p1];
+		if (p1 < p2) {
+			memmove(trial + p1, trial + p1 + 1, (p2 - p1) * sizeof(int));
+		} else {
+			memmove(trial + p2 + 1, trial + p2, (p1 - p2) * sizeof(int));
+		}
+		trial[p2] = row;
+		return;
+	}
+	flipTour(plan, tour, trial, p1 < p2 ? p1 : p2, p1 < p2 ? p2 : p1);
+}
+
+/* Pareto local search over visit order with standby waits: maxMoves times,
+   a random neighbour of a random member of the front is scored and
+   offered to it. front gets the non-dominated tours found, at most
+   PARETO_ARCHIVE of them. Returns how many there are */
+int solvePareto(const struct Plan *plan, struct ParetoFront *front, int maxMoves) {
+	int n = plan->length;
+	int trial[MAX_ROWS];
+	int walking, waiting;
+
+	front->size = 0;
+	int total = scoreObjectives(plan, plan->startTour, &walking, &waiting);
+	offerTour(front, plan->startTour, n, walking, waiting, total);
+	if (n < 4) {
+		return front->size;
+	}
+
+	for (int m = 0; m < maxMoves; m++) {
+		int a = rand() % front->size;
+		randomNeighbour(plan, front->tours[a], trial);
+		total = scoreObjectives(plan, trial, &walking, &waiting);
+		planMetrics.movesEvaluated++;
+
+		if (offerTour(front, trial, n, walking, waiting, total)) {
+			planMetrics.movesAccepted++;
+		}
+	}
+	return front->size;
+}
+
+/* the member of the front with the lowest WalkingWeight x walking plus
+   WaitingWeight x waiting, ties going to the shorter day */
+int preferredTour(const struct Plan *plan, const struct ParetoFront *front) {
+	int best = 0;
+	double bestScore = 0;
+	for (int a = 0; a < front->size; a++) {
+		double score = plan->walkingWeight * front->walking[a] + plan->waitingWeight * front->waiting[a];
+		if (a == 0 || score < bestScore || (score == bestScore && front->total[a] < front->total[best])) {
+			best = a;
+			bestScore = score;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,168 @@
+// park.c
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/*............................................................................*/
+
+/* Park Functions:
+	1. indexPark -> builds the label to row index of a park
+	2. loadPark -> loads the park-wide matrices once from a plan file that
+	   lists every attraction
+	3. gatherPlan -> builds a plan over some of the park's attractions from
+	   the preloaded matrices
+	4. freePark -> frees what loadPark or indexPark allocated
+
+   The walking, wait and ride matrices are the same for every guest in a
+   park, and only the attractions a guest picks change. A struct Park is
+   a plan over every attraction of the park (loaded, closed under detours
+   and tabled once like any plan) plus an index from attraction label to
+   row. Serving a guest is then a gather: each of the k picked rows is
+   looked up in the index and its walks, waits, return waits, scenario
+   waits and ride are copied into a dense plan of its own, which is
+   O(k^2 + k * slices) work on memory already in cache and never touches
+   json. The gathered plan is an ordinary plan, so every solver, the
+   kernels and the symmetry checks work on it unchanged.
+
+   The park's walks are the shortest over the whole park, so a gathered
+   walk may pass attractions the guest didn't pick. Those are not plan
+   rows, so the gathered plan keeps the walk and drops its via stops. */
+
+
+/* builds park->rowOfLabel from the labels of the park plan. The entrance
+   label maps to row 0. Returns 0, or RESULT_ERROR for a negative label */
+int indexPark(struct Park *park) {
+	const struct Plan *plan = &park->plan;
+	int largest = 0;
+
+	for (int i = 0; i < plan->length; i++) {
+		if (plan->key[i] < 0) {
+			printf("Error: attraction label %d can't be indexed.\n", plan->key[i]);
+			return RESULT_ERROR;
+		}
+		largest = plan->key[i] > largest ? plan->key[i] : largest;
+	}
+
+	park->numLabels = largest + 1;
+	park->rowOfLabel = (int*)malloc(park->numLabels * sizeof(int));
+	for (int label = 0; label < park->numLabels; label++) {
+		park->rowOfLabel[label] = RESULT_ERROR;
+	}
+	for (int i = plan->length - 2; i >= 0; i--) {
+		park->rowOfLabel[plan->key[i]] = i;
+	}
+	return 0;
+}
+
+/* loads the park-wide matrices from plan json whose AttractionsToInclude
+   lists every attraction of the park, entrance at both ends. Returns 0, or
+   RESULT_ERROR after printing what was wrong */
+int loadPark(const cJSON *json, struct Park *park) {
+	memset(park, 0, sizeof(struct Park));
+	if (loadPlan(json, &park->plan) != 0) {
+		return RESULT_ERROR;
+	}
+	if (indexPark(park) != 0) {
+		freePlan(&park->plan);
+		return RESULT_ERROR;
+	}
+	return 0;
+}
+
+/* builds a plan over the k attractions in labels (entrance at both ends,
+   in the order of the starting tour) from the park's matrices, with the
+   day running from startTime to stopTime. Passes keep the park's groups
+   and limits but none is reserved. Returns 0, or RESULT_ERROR if a label
+   isn't in the park, the list doesn't start and end at the entrance, or
+   an attraction (or the entrance) appears twice in between */
+int gatherPlan(const struct Park *park, const int *labels, int k, int startTime, int stopTime, struct Plan *plan) {
+	const struct Plan *from = &park->plan;
+	int m = from->length;
+	int slices = from->numSlices;
+	int rows[MAX_ROWS];
+	unsigned char seen[MAX_ROWS] = {0};
+
+	if (k < 3 || k > MAX_ROWS) {
+		printf("Error: a plan needs between 3 and %d stops.\n", MAX_ROWS);
+		return RESULT_ERROR;
+	}
+	for (int i = 0; i < k; i++) {
+		int label = labels[i];
+		rows[i] = (label >= 0 && label < park->numLabels) ? park->rowOfLabel[label] : RESULT_ERROR;
+		if (rows[i] < 0) {
+			printf("Error: attraction %d is not in the park.\n", label);
+			return RESULT_ERROR;
+		}
+	}
+
+	// the entrance at both ends and nowhere else, every attraction once
+	if (rows[0] != 0 || rows[k - 1] != 0) {
+		printf("Error: a plan starts and ends at the entrance.\n");
+		return RESULT_ERROR;
+	}
+	for (int i = 1; i < k - 1; i++) {
+		if (rows[i] == 0) {
+			printf("Error: the entrance can only be at the ends of a plan.\n");
+			return RESULT_ERROR;
+		}
+		if (seen[rows[i]]) {
+			printf("Error: attraction %d is in the plan twice.\n", labels[i]);
+			return RESULT_ERROR;
+		}
+		seen[rows[i]] = 1;
+	}
+	// the exit is the park's exit row, so the walk back is the park's too
+	rows[k - 1] = m - 1;
+
+	memset(plan, 0, sizeof(struct Plan));
+	allocPlan(plan, k, slices);
+	plan->segment = from->segment;
+	plan->startTime = startTime;
+	plan->stopTime = stopTime;
+	plan->matrixStart = from->matrixStart;
+	plan->planId = from->planId;
+	plan->walkingWeight = from->walkingWeight;
+	plan->waitingWeight = from->waitingWeight;
+	plan->numGroups = from->numGroups;
+	memcpy(plan->groupLimit, from->groupLimit, sizeof(plan->groupLimit));
+	plan->numScenarios = from->numScenarios;
+	memcpy(plan->scenarioWeight, from->scenarioWeight, sizeof(plan->scenarioWeight));
+
+	for (int i = 0; i < k; i++) {
+		int row = rows[i];
+		const int *walk = from->walk + row * m;
+		for (int j = 0; j < k; j++) {
+			plan->walk[i * k + j] = walk[rows[j]];
+		}
+
+		plan->key[i] = from->key[row];
+		plan->rideTime[i] = from->rideTime[row];
+		plan->priority[i] = from->priority[row];
+		plan->passGroup[i] = from->passGroup[row];
+		plan->startTour[i] = i;
+		memcpy(plan->waitTable + i * slices, from->waitTable + row * slices, slices * sizeof(int));
+		memcpy(plan->returnTable + i * slices, from->returnTable + row * slices, slices * sizeof(int));
+		memcpy(plan->scenarioTable + i * slices * SCENARIO_LANES, from->scenarioTable + row * slices * SCENARIO_LANES,
+			slices * SCENARIO_LANES * sizeof(int));
+	}
+	plan->priority[0] = 0;
+	plan->priority[k - 1] = 0;
+
+	detectSymmetry(plan);
+	return 0;
+}
+
+// frees what loadPark or indexPark allocated
+void freePark(struct Park *park) {
+	freePlan(&park->plan);
+	free(park->rowOfLabel);
+	memset(park, 0, sizeof(struct Park));
+}
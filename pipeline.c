@@ -0,0 +1,515 @@
+// pipeline.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* most solver threads a batch starts, and so most loaders */
+#define MAX_THREADS 16
+
+/* slots of the queue into each solver and out of it, a power of two */
+#define QUEUE_SLOTS 4
+
+/* jobs in flight per solver, enough to keep it fed while one is written */
+#define JOBS_PER_SOLVER 3
+
+/* bytes the two ends of a queue keep apart so they don't share a line */
+#define CACHE_LINE 64
+
+/* how a thread waits on a full or empty queue: spin, then yield, then sleep */
+#define SPIN_LIMIT 64
+#define YIELD_LIMIT 1024
+#define SLEEP_NS 100000
+
+/*............................................................................*/
+
+/* Pipeline Functions:
+	1. initQueue -> an empty single-producer, single-consumer ring
+	2. pushJob / popJob -> hand a job to the other end of a ring, without
+	   blocking
+	3. backOff -> waits a little longer each time a ring is full or empty
+	4. readInto -> reads a plan file into a job's reusable text buffer
+	5. nextSolver -> the next of the solvers a loader feeds
+	6. loadFiles -> what each loader thread runs
+	7. solveJobs -> what each solver thread runs
+	8. writeString / writeResult -> one json line with the solved tour of
+	   a job
+	9. runBatch -> reads, solves and writes a list of plan files with the
+	   three stages overlapping
+
+   A nightly batch reading, solving and writing one plan after another
+   leaves the cores idle while it reads and the disk idle while it solves.
+   runBatch splits the work into three stages joined by bounded rings:
+   loader threads read and parse the files into plans, a pool of solver
+   threads optimizes order and passes as fastpass does, and the calling
+   thread writes one json line per plan. Each stage works on the next plan
+   while the others work on theirs.
+
+   Every ring has one producer and one consumer, so it needs no lock: the
+   producer alone moves tail and the consumer alone moves head, each with
+   a release store the other end reads with acquire. The two ends sit on
+   separate cache lines and each keeps its last look at the other's index,
+   so a push or pop only touches the shared line when the ring looks full
+   or empty. Loader l feeds the solvers j with j % loaders == l, each
+   solver has its own ring to the writer, and the writer gives each job
+   back to the loader that owns it through a ring per loader.
+
+   A job is a struct Planner plus the text of its file. Jobs are made once
+   per batch and go round and round, so the text buffer only grows and the
+   context's scratch arrays are reused. plannerLoad reloads each plan into
+   the tables the job's context already holds, which only grow when a plan
+   is larger than any the job carried before, so once the jobs have seen
+   the largest plan the only allocation per file is cJSON's json tree. The rings
+   bound the jobs in flight, so a slow writer holds the solvers back
+   instead of filling memory. Results come out in the order plans finish,
+   each tagged with its file. */
+
+
+// one plan file on its way through the stages
+struct Job {
+	struct Planner ctx;
+	char *text;                 // file contents, reused from file to file
+	size_t capacity;            // bytes text can hold
+	char *file;
+	int owner;                  // loader the job goes back to
+	int cost;                   // total time of the solved tour, RESULT_ERROR if not loaded
+};
+
+/* a bounded ring of jobs with one producer and one consumer. Indexes only
+   grow, a slot is index & mask. Every part fills a whole line, so the rings
+   allocated side by side never share one */
+struct Queue {
+	unsigned long tail;         // next slot to fill, moved by the producer only
+	unsigned long headSeen;     // the producer's last look at head
+	char producerPad[CACHE_LINE - 2 * sizeof(unsigned long)];
+	unsigned long head;         // next slot to empty, moved by the consumer only
+	unsigned long tailSeen;     // the consumer's last look at tail
+	char consumerPad[CACHE_LINE - 2 * sizeof(unsigned long)];
+	unsigned long mask;
+	struct Job **slots;
+	char ringPad[CACHE_LINE - sizeof(unsigned long) - sizeof(struct Job**)];
+};
+
+// what every thread of a batch shares
+struct Batch {
+	char **files;
+	int count;
+	int loaders;
+	int solvers;
+	int loopsPerStop;
+	struct Queue *toSolver;     // one per solver, from its loader
+	struct Queue *toWriter;     // one per solver
+	struct Queue *toLoader;     // one per loader, jobs coming back
+	int stopping;               // set when a loader couldn't start, __atomic only
+	double loadSeconds;         // summed busy time of the loaders, under lock
+	double solveSeconds;        // and of the solvers
+	pthread_mutex_t lock;
+};
+
+// the thread arguments of one loader or solver
+struct Stage {
+	struct Batch *batch;
+	int index;
+};
+
+// pushed down every ring once a loader has no more files
+static struct Job endOfBatch;
+
+// readies q to hold slots jobs, a power of two
+static void initQueue(struct Queue *q, int slots) {
+	memset(q, 0, sizeof(struct Queue));
+	q->mask = slots - 1;
+	q->slots = (struct Job**)malloc(slots * sizeof(struct Job*));
+}
+
+// adds job at the tail of q, false if q is full. Producer only
+static bool pushJob(struct Queue *q, struct Job *job) {
+	unsigned long tail = q->tail;
+	if (tail - q->headSeen > q->mask) {
+		q->headSeen = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+		if (tail - q->headSeen > q->mask) {
+			return false;
+		}
+	}
+	q->slots[tail & q->mask] = job;
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+// takes the job at the head of q, NULL if q is empty. Consumer only
+static struct Job* popJob(struct Queue *q) {
+	unsigned long head = q->head;
+	if (head == q->tailSeen) {
+		q->tailSeen = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+		if (head == q->tailSeen) {
+			return NULL;
+		}
+	}
+	struct Job *job = q->slots[head & q->mask];
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+	return job;
+}
+
+/* waits after the spins-th failed push or pop in a row: not at all for the
+   first few, then gives up the core, then sleeps so an idle stage costs
+   nothing */
+static void backOff(int *spins) {
+	(*spins)++;
+	if (*spins < SPIN_LIMIT) {
+		return;
+	}
+	if (*spins < YIELD_LIMIT) {
+		sched_yield();
+		return;
+	}
+	struct timespec pause = {0, SLEEP_NS};
+	nanosleep(&pause, NULL);
+}
+
+// pushes job onto q, waiting while q is full
+static void pushWaiting(struct Queue *q, struct Job *job) {
+	int spins = 0;
+	while (!pushJob(q, job)) {
+		backOff(&spins);
+	}
+}
+
+/* reads filename into job->text, null terminated, growing the buffer only
+   when the file is larger than any before. Returns 0, or RESULT_ERROR */
+static int readInto(struct Job *job, char *filename) {
+	long size = getSize(filename);
+	FILE *fp = fopen(filename, "r");
+	if (fp == NULL || size < 0) {
+		printf("Error: Unable to open %s.\n", filename);
+		if (fp != NULL) {
+			fclose(fp);
+		}
+		return RESULT_ERROR;
+	}
+
+	if ((size_t)size + 1 > job->capacity) {
+		free(job->text);
+		job->capacity = (size_t)size + 1;
+		job->text = (char*)malloc(job->capacity);
+	}
+	size_t read = fread(job->text, 1, size, fp);
+	job->text[read] = '\0';
+	fclose(fp);
+	return 0;
+}
+
+// the solver after j of the ones loader l feeds
+static int nextSolver(const struct Batch *batch, int l, int j) {
+	return j + batch->loaders < batch->solvers ? j + batch->loaders : l;
+}
+
+/* loader l: reads and loads files l, l + loaders, ... into its free jobs
+   and hands each to the next of its solvers with room in its ring, then
+   ends their rings */
+static void* loadFiles(void *arg) {
+	struct Stage *stage = (struct Stage*)arg;
+	struct Batch *batch = stage->batch;
+	int l = stage->index;
+	int fed = (batch->solvers - l + batch->loaders - 1) / batch->loaders;
+	int next = l;
+	double busy = 0;
+
+	for (int f = l; f < batch->count && !__atomic_load_n(&batch->stopping, __ATOMIC_RELAXED); f += batch->loaders) {
+		int spins = 0;
+		struct Job *job;
+		while ((job = popJob(&batch->toLoader[l])) == NULL) {
+			backOff(&spins);
+		}
+
+		double start = wallClock();
+		job->file = batch->files[f];
+		job->cost = RESULT_ERROR;
+		// a file that fails leaves the job's tables for its next file
+		if (readInto(job, job->file) != 0 || plannerLoad(&job->ctx, job->text) != 0) {
+			job->ctx.loaded = 0;
+		}
+		busy += wallClock() - start;
+
+		// the first of the loader's solvers with room, from the next one on
+		spins = 0;
+		int j = next;
+		bool pushed = false;
+		while (!pushed) {
+			for (int tries = 0; tries < fed && !pushed; tries++) {
+				pushed = pushJob(&batch->toSolver[j], job);
+				j = pushed ? j : nextSolver(batch, l, j);
+			}
+			if (!pushed) {
+				backOff(&spins);
+			}
+		}
+		next = nextSolver(batch, l, j);
+	}
+
+	for (int j = l; j < batch->solvers; j += batch->loaders) {
+		pushWaiting(&batch->toSolver[j], &endOfBatch);
+	}
+
+	pthread_mutex_lock(&batch->lock);
+	batch->loadSeconds += busy;
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
+}
+
+/* solver j: optimizes the order and passes of every job its loader hands
+   it, loopsPerStop moves per stop, and passes it on to the writer */
+static void* solveJobs(void *arg) {
+	struct Stage *stage = (struct Stage*)arg;
+	struct Batch *batch = stage->batch;
+	int j = stage->index;
+	double busy = 0;
+
+	resetMetrics();
+	while (true) {
+		int spins = 0;
+		struct Job *job;
+		while ((job = popJob(&batch->toSolver[j])) == NULL) {
+			backOff(&spins);
+		}
+		if (job == &endOfBatch) {
+			pushWaiting(&batch->toWriter[j], job);
+			break;
+		}
+
+		if (job->ctx.loaded) {
+			double start = wallClock();
+			job->cost = plannerSolve(&job->ctx, 0, batch->loopsPerStop * job->ctx.plan.length);
+			busy += wallClock() - start;
+		}
+		pushWaiting(&batch->toWriter[j], job);
+	}
+
+	pthread_mutex_lock(&batch->lock);
+	batch->solveSeconds += busy;
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
+}
+
+// writes s as a json string, escaping quotes and backslashes
+static void writeString(FILE *out, const char *s) {
+	fputc('"', out);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', out);
+		}
+		fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+/* one json line per job:
+   {"file":"a.json","planId":7,"cost":493,"tour":[0,...,0],"passes":[12],"offTimes":[...]}
+   or {"file":"a.json","error":"not loaded"} */
+static void writeResult(FILE *out, const struct Job *job) {
+	int labels[MAX_ROWS], offTimes[MAX_ROWS];
+	unsigned char passes[MAX_ROWS];
+
+	fputs("{\"file\":", out);
+	writeString(out, job->file);
+	if (job->cost < 0) {
+		fputs(",\"error\":\"not loaded\"}\n", out);
+		return;
+	}
+
+	int n = plannerSchedule(&job->ctx, labels, offTimes, passes);
+	fprintf(out, ",\"planId\":%d,\"cost\":%d,\"tour\":[", job->ctx.plan.planId, job->cost);
+	for (int i = 0; i < n; i++) {
+		fprintf(out, i == 0 ? "%d" : ",%d", labels[i]);
+	}
+	fputs("],\"passes\":[", out);
+	bool first = true;
+	for (int i = 1; i < n - 1; i++) {
+		if (passes[i]) {
+			fprintf(out, first ? "%d" : ",%d", labels[i]);
+			first = false;
+		}
+	}
+	fputs("],\"offTimes\":[", out);
+	for (int i = 0; i < n; i++) {
+		fprintf(out, i == 0 ? "%d" : ",%d", offTimes[i]);
+	}
+	fputs("]}\n", out);
+}
+
+/* reads, solves and writes the count plan files in files, one json line
+   each to out in the order they finish. "loaders" threads read and load
+   the files, "solvers" threads (0 for one per core) optimize order and
+   passes with loopsPerStop moves per stop, and the calling thread writes.
+   There are never more loaders than solvers. Files that can't be read or
+   loaded are reported with printf, so out should not be stdout unless
+   stdout has been pointed elsewhere. stats (optional) gets the
+   plans written, the files that failed, the wall time and the busy time of
+   each stage. Returns 0, or RESULT_ERROR if no thread could start or a
+   loader failed to start, in which case the files it had are missing */
+int runBatch(char **files, int count, int loaders, int solvers, int loopsPerStop, FILE *out, struct BatchStats *stats) {
+	struct Batch batch;
+	struct Stage stages[2 * MAX_THREADS];
+	pthread_t ids[2 * MAX_THREADS];
+	double start = wallClock();
+	int result = 0;
+
+	if (solvers <= 0) {
+		solvers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	solvers = solvers < 1 ? 1 : (solvers > MAX_THREADS ? MAX_THREADS : solvers);
+	loaders = loaders < 1 ? 1 : (loaders > solvers ? solvers : loaders);
+
+	memset(&batch, 0, sizeof(struct Batch));
+	batch.files = files;
+	batch.count = count;
+	batch.loaders = loaders;
+	batch.solvers = solvers;
+	batch.loopsPerStop = loopsPerStop;
+	pthread_mutex_init(&batch.lock, NULL);
+
+	// the rings of each end on lines of their own
+	void *rings;
+	if (posix_memalign(&rings, CACHE_LINE, (2 * solvers + loaders) * sizeof(struct Queue)) != 0) {
+		printf("Error: can't allocate the batch queues.\n");
+		return RESULT_ERROR;
+	}
+	batch.toSolver = (struct Queue*)rings;
+	batch.toWriter = batch.toSolver + solvers;
+	batch.toLoader = batch.toWriter + solvers;
+
+	// each loader owns JOBS_PER_SOLVER jobs per solver it feeds
+	int numJobs = JOBS_PER_SOLVER * solvers;
+	struct Job *jobs = (struct Job*)calloc(numJobs, sizeof(struct Job));
+	for (int j = 0; j < solvers; j++) {
+		initQueue(&batch.toSolver[j], QUEUE_SLOTS);
+		initQueue(&batch.toWriter[j], QUEUE_SLOTS);
+	}
+	for (int l = 0; l < loaders; l++) {
+		int fed = (solvers - l + loaders - 1) / loaders;
+		int slots = 1;
+		while (slots < JOBS_PER_SOLVER * fed) {
+			slots *= 2;
+		}
+		initQueue(&batch.toLoader[l], slots);
+	}
+	for (int i = 0; i < numJobs; i++) {
+		plannerInit(&jobs[i].ctx);
+		jobs[i].owner = (i / JOBS_PER_SOLVER) % loaders;
+		pushJob(&batch.toLoader[jobs[i].owner], &jobs[i]);
+	}
+
+	// solvers first, so loaders only feed solvers that are running
+	int running = 0;
+	for (int j = 0; j < solvers; j++) {
+		stages[j].batch = &batch;
+		stages[j].index = j;
+		if (pthread_create(&ids[j], NULL, solveJobs, &stages[j]) != 0) {
+			break;
+		}
+		running++;
+	}
+	if (running == 0) {
+		printf("Error: can't start a solver thread.\n");
+		result = RESULT_ERROR;
+	} else if (running < solvers) {
+		printf("Error: started %d of %d solver threads.\n", running, solvers);
+		result = RESULT_ERROR;
+	}
+
+	// a loader that can't start stops the others, and the caller ends its rings
+	int started = 0;
+	for (int l = 0; l < loaders && result == 0; l++) {
+		stages[solvers + l].batch = &batch;
+		stages[solvers + l].index = l;
+		if (pthread_create(&ids[solvers + l], NULL, loadFiles, &stages[solvers + l]) != 0) {
+			printf("Error: started %d of %d loader threads.\n", l, loaders);
+			__atomic_store_n(&batch.stopping, 1, __ATOMIC_RELAXED);
+			result = RESULT_ERROR;
+			break;
+		}
+		started++;
+	}
+	if (running > 0) {
+		for (int j = 0; j < solvers; j++) {
+			if (j >= running || j % loaders >= started) {
+				pushWaiting(&batch.toSolver[j], &endOfBatch);
+			}
+		}
+	}
+
+	// the writer: every solver's ring in turn until each has ended
+	struct BatchStats totals;
+	memset(&totals, 0, sizeof(struct BatchStats));
+	double writing = 0;
+	int ended = solvers - running;
+	int spins = 0;
+	while (ended < solvers) {
+		bool idle = true;
+		for (int j = 0; j < running; j++) {
+			struct Job *job = popJob(&batch.toWriter[j]);
+			if (job == NULL) {
+				continue;
+			}
+			idle = false;
+			if (job == &endOfBatch) {
+				ended++;
+				continue;
+			}
+
+			double begin = wallClock();
+			writeResult(out, job);
+			writing += wallClock() - begin;
+			if (job->cost < 0) {
+				totals.failed++;
+			} else {
+				totals.plans++;
+			}
+			pushJob(&batch.toLoader[job->owner], job);
+		}
+		if (idle) {
+			backOff(&spins);
+		} else {
+			spins = 0;
+		}
+	}
+	fflush(out);
+
+	for (int j = 0; j < running; j++) {
+		pthread_join(ids[j], NULL);
+	}
+	for (int l = 0; l < started; l++) {
+		pthread_join(ids[solvers + l], NULL);
+	}
+
+	totals.seconds = wallClock() - start;
+	totals.loadSeconds = batch.loadSeconds;
+	totals.solveSeconds = batch.solveSeconds;
+	totals.writeSeconds = writing;
+	if (stats != NULL) {
+		*stats = totals;
+	}
+
+	for (int i = 0; i < numJobs; i++) {
+		plannerFree(&jobs[i].ctx);
+		free(jobs[i].text);
+	}
+	for (int q = 0; q < 2 * solvers + loaders; q++) {
+		free(batch.toSolver[q].slots);
+	}
+	free(jobs);
+	free(rings);
+	pthread_mutex_destroy(&batch.lock);
+	return result;
+}
@@ -0,0 +1,574 @@
+// plan.c
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/*............................................................................*/
+
+/* Plan Functions:
+	1. readPlanFile -> reads and parses a plan json file
+	2. parseLabel -> returns the attraction number of "HS37" or 37 style entries
+	3. findRow -> returns the row of an attraction label in the plan matrices
+	4. labelsToTour -> turns a tour of attraction labels into a tour of rows
+	5. tourToLabels -> turns a tour of rows back into attraction labels
+	6. readMatrix -> reads a json matrix into a flat array, checking its shape
+	7. buildWaitTable -> averages each wait slice with the next one
+	8. detectSymmetry -> finds out whether the direction of a tour can change
+	   its walking or its total time
+	9. allocPlan -> allocates every table of a plan, or reuses the ones it
+	   already has when they are large enough
+	10. loadPlan / reloadPlan -> copies everything the solvers need out of
+	   the json and precomputes the wait tables, reloadPlan into the tables
+	   of the plan loaded before
+	11. freePlan -> frees what allocPlan allocated
+	12. tableAt -> looks up a precomputed wait table at a time of day
+	13. rescheduleRoute -> recomputes the timeline of a tour of any length from
+		a position on
+	14. rescheduleFrom -> rescheduleRoute for a tour of the full plan length
+	15. scheduleTour -> computes the whole timeline of a tour, returns total time
+	16. walkingCost -> walking minutes of a tour, getCost() on plan rows
+	17. suffixCost -> scores a changed tour against the current timeline,
+		stopping as soon as the two timelines meet again
+	18. evaluateRouteSuffix -> suffixCost, counted as a scored move
+	19. evaluateSuffix -> evaluateRouteSuffix for a tour of the full length
+	20. printSchedule -> prints arrival, mount and dismount times of a tour and
+		the stops each walk passes, and warns when it runs past park close */
+
+
+// reads and parses a plan json file, NULL if it can't be read
+cJSON* readPlanFile(char *filename) {
+	startPhase(PHASE_READ);
+	long size = getSize(filename);
+	FILE *fp = fopen(filename, "r");
+	if (fp == NULL || size < 0) {
+		printf("Error: Unable to open the file.\n");
+		if (fp != NULL) {
+			fclose(fp);
+		}
+		return NULL;
+	}
+
+	// the buffer is null terminated so cJSON doesn't read past the file
+	char *buffer = (char*)malloc(size + 1);
+	size_t read = fread(buffer, 1, size, fp);
+	buffer[read] = '\0';
+	fclose(fp);
+	endPhase(PHASE_READ);
+
+	startPhase(PHASE_PARSE);
+	cJSON *json = cJSON_Parse(buffer);
+	free(buffer);
+	endPhase(PHASE_PARSE);
+
+	if (json == NULL) {
+		const char *error_ptr = cJSON_GetErrorPtr();
+		if (error_ptr != NULL) {
+			printf("Error: %s\n", error_ptr);
+		}
+	}
+	return json;
+}
+
+// returns the attraction number of "HS37" or 37 style entries
+int parseLabel(const cJSON *item) {
+	if (cJSON_IsNumber(item)) {
+		return item->valueint;
+	}
+	if (cJSON_IsString(item)) {
+		// skip the park prefix without modifying the string like strtok does
+		const char *s = item->valuestring;
+		while (*s != '\0' && !isdigit((unsigned char)*s)) {
+			s++;
+		}
+		return atoi(s);
+	}
+	return RESULT_ERROR;
+}
+
+/* returns the row of an attraction label in the plan matrices. The entrance
+   is on both ends of AttractionsToInclude, so interior rows are searched first
+   and the entrance resolves to row 0 */
+int findRow(const struct Plan *plan, int label) {
+	for (int i = 1; i < plan->length - 1; i++) {
+		if (plan->key[i] == label) {
+			return i;
+		}
+	}
+	if (plan->key[0] == label) {
+		return 0;
+	}
+	return RESULT_ERROR;
+}
+
+// turns a tour of attraction labels into a tour of rows
+void labelsToTour(const struct Plan *plan, const int *labels, int *tour) {
+	tour[0] = 0;
+	for (int i = 1; i < plan->length - 1; i++) {
+		tour[i] = findRow(plan, labels[i]);
+	}
+	tour[plan->length - 1] = plan->length - 1;
+}
+
+// turns a tour of rows back into attraction labels
+void tourToLabels(const struct Plan *plan, const int *tour, int *labels) {
+	for (int i = 0; i < plan->length; i++) {
+		labels[i] = plan->key[tour[i]];
+	}
+}
+
+// reads a rows x cols json matrix into a flat array, RESULT_ERROR on bad shape
+int readMatrix(const cJSON *data, int rows, int cols, int *out, const char *name) {
+	int row_idx = 0;
+	cJSON *rowArray, *cellValue;
+
+	cJSON_ArrayForEach(rowArray, data) {
+		if (row_idx >= rows) {
+			printf("Too many rows in %s.\n", name);
+			return RESULT_ERROR;
+		}
+
+		int col_idx = 0;
+		cJSON_ArrayForEach(cellValue, rowArray) {
+			if (col_idx >= cols) {
+				printf("Too many columns in %s.\n", name);
+				return RESULT_ERROR;
+			}
+			out[row_idx * cols + col_idx] = cellValue->valueint;
+			col_idx++;
+		}
+
+		if (col_idx != cols) {
+			printf("Invalid number of columns in row %d of %s.\n", row_idx, name);
+			return RESULT_ERROR;
+		}
+		row_idx++;
+	}
+
+	if (row_idx != rows) {
+		printf("Invalid number of rows in %s.\n", name);
+		return RESULT_ERROR;
+	}
+	return 0;
+}
+
+/* averages every slice of a wait matrix with the next one, which is what
+   calculateWait() does for each lookup. The last slice has no neighbour and
+   is used as is */
+void buildWaitTable(const int *matrix, int rows, int slices, int *table) {
+	for (int i = 0; i < rows; i++) {
+		const int *row = matrix + i * slices;
+		for (int s = 0; s < slices; s++) {
+			int next = (s + 1 < slices) ? s + 1 : s;
+			table[i * slices + s] = (row[s] + row[next]) / 2;
+		}
+	}
+}
+
+// reads a whole number from the plan, or the fallback if it is missing
+static int readNumber(const cJSON *json, const char *name, int fallback) {
+	cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+	if (!cJSON_IsNumber(item)) {
+		return fallback;
+	}
+	return item->valueint;
+}
+
+// reads a number like readNumber, keeping its fraction
+static double readDouble(const cJSON *json, const char *name, double fallback) {
+	cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+	if (!cJSON_IsNumber(item)) {
+		return fallback;
+	}
+	return item->valuedouble;
+}
+
+/* sets symmetricWalk when every tour walks as far as its reverse: the walk
+   between two attractions is the same both ways and the entrance rows at
+   the two ends are the same spot. Sets flatWaits when no standby wait
+   changes during the day. With both, a tour without passes takes exactly
+   as long as its reverse, so the exhaustive searches only score one of
+   the two */
+void detectSymmetry(struct Plan *plan) {
+	int n = plan->length;
+	int slices = plan->numSlices;
+
+	// a reversed tour leaves the entrance toward its last attraction
+	plan->symmetricWalk = 1;
+	for (int i = 1; i < n - 1; i++) {
+		if (plan->walk[i] != plan->walk[i * n + n - 1]) {
+			plan->symmetricWalk = 0;
+		}
+		for (int j = 1; j < i; j++) {
+			if (plan->walk[i * n + j] != plan->walk[j * n + i]) {
+				plan->symmetricWalk = 0;
+			}
+		}
+	}
+
+	plan->flatWaits = 1;
+	for (int i = 0; i < n * slices && plan->flatWaits; i++) {
+		if (plan->waitTable[i] != plan->waitTable[i - i % slices]) {
+			plan->flatWaits = 0;
+		}
+	}
+}
+
+// frees the tables of a plan
+static void freeTables(struct Plan *plan) {
+	free(plan->key);
+	free(plan->rideTime);
+	free(plan->walk);
+	free(plan->walkVia);
+	free(plan->waitTable);
+	free(plan->startTour);
+	free(plan->priority);
+	free(plan->returnTable);
+	free(plan->passGroup);
+	free(plan->passFixed);
+	free(plan->scenarioTable);
+	free(plan->scratchTable);
+}
+
+/* allocates every table of a plan with n stops and the given number of
+   timeslices and picks the evaluation kernels for its length. Everything
+   starts zeroed, with no row able to take a pass. A plan that still holds
+   tables from an earlier load (reloadPlan) keeps them if they have room,
+   and otherwise gets new ones as large as the largest plan so far */
+void allocPlan(struct Plan *plan, int n, int slices) {
+	plan->length = n;
+	plan->numSlices = slices;
+	plan->kernels = selectKernels(n);
+
+	if (n > plan->rowCapacity || slices > plan->sliceCapacity) {
+		int rows = n > plan->rowCapacity ? n : plan->rowCapacity;
+		int cols = slices > plan->sliceCapacity ? slices : plan->sliceCapacity;
+		freeTables(plan);
+		plan->key = (int*)malloc(rows * sizeof(int));
+		plan->rideTime = (int*)malloc(rows * sizeof(int));
+		plan->walk = (int*)malloc(rows * rows * sizeof(int));
+		plan->walkVia = (int*)malloc(rows * rows * sizeof(int));
+		plan->waitTable = (int*)malloc(rows * cols * sizeof(int));
+		plan->startTour = (int*)malloc(rows * sizeof(int));
+		plan->priority = (int*)malloc(rows * sizeof(int));
+		plan->returnTable = (int*)malloc(rows * cols * sizeof(int));
+		plan->passGroup = (int*)malloc(rows * sizeof(int));
+		plan->passFixed = (unsigned char*)malloc(rows * sizeof(unsigned char));
+		plan->scenarioTable = (int*)malloc(rows * cols * SCENARIO_LANES * sizeof(int));
+		plan->scratchTable = (int*)malloc(2 * rows * cols * sizeof(int));
+		plan->rowCapacity = rows;
+		plan->sliceCapacity = cols;
+	}
+
+	memset(plan->key, 0, n * sizeof(int));
+	memset(plan->rideTime, 0, n * sizeof(int));
+	memset(plan->walk, 0, n * n * sizeof(int));
+	for (int c = 0; c < n * n; c++) {
+		plan->walkVia[c] = RESULT_ERROR;
+	}
+	memset(plan->waitTable, 0, n * slices * sizeof(int));
+	memset(plan->startTour, 0, n * sizeof(int));
+	memset(plan->priority, 0, n * sizeof(int));
+
+	memset(plan->returnTable, 0, n * slices * sizeof(int));
+	memset(plan->passFixed, 0, n * sizeof(unsigned char));
+	for (int i = 0; i < n; i++) {
+		plan->passGroup[i] = RESULT_ERROR;
+	}
+
+	memset(plan->scenarioTable, 0, n * slices * SCENARIO_LANES * sizeof(int));
+}
+
+/* everything loadPlan does after the plan is cleared, on the tables the plan
+   already holds. Leaves the tables allocated on RESULT_ERROR */
+static int readPlan(const cJSON *json, struct Plan *plan) {
+	cJSON *attractionKey = cJSON_GetObjectItemCaseSensitive(json, "AttractionsToInclude");
+	int n = cJSON_GetArraySize(attractionKey);
+	if (n < 3 || n > MAX_ROWS) {
+		printf("Error: a plan needs between 3 and %d stops.\n", MAX_ROWS);
+		return RESULT_ERROR;
+	}
+
+	cJSON *waitData = cJSON_GetObjectItemCaseSensitive(json, "WaitMatrix");
+	int slices = readNumber(json, "NumTimeslices", cJSON_GetArraySize(cJSON_GetArrayItem(waitData, 0)));
+	if (slices < 1 || slices > MAX_COLS) {
+		printf("Error: a plan needs between 1 and %d timeslices.\n", MAX_COLS);
+		return RESULT_ERROR;
+	}
+
+	plan->segment = readNumber(json, "TimesliceLength", 15);
+	plan->startTime = readNumber(json, "Start", 0);
+	plan->stopTime = readNumber(json, "Stop", 24 * 60);
+
+	// the day can't run past the park closing to the guest either
+	int parkCloses = readNumber(json, "ParkClosesToGeneralPublic", plan->stopTime);
+	if (parkCloses < plan->stopTime) {
+		plan->stopTime = parkCloses;
+	}
+	plan->matrixStart = readNumber(json, "MatrixStartTime", plan->startTime);
+	plan->planId = readNumber(json, "PlanID", 0);
+
+	allocPlan(plan, n, slices);
+
+	cJSON *item;
+	int j = 0;
+	cJSON_ArrayForEach(item, attractionKey) {
+		plan->key[j++] = parseLabel(item);
+	}
+
+	j = 0;
+	cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(json, "RideMatrix")) {
+		if (j < n) {
+			plan->rideTime[j++] = item->valueint;
+		}
+	}
+
+	if (readMatrix(cJSON_GetObjectItemCaseSensitive(json, "DistanceMatrix"), n, n, plan->walk, "DistanceMatrix") != 0
+		|| readMatrix(waitData, n, slices, plan->scratchTable, "WaitMatrix") != 0) {
+		return RESULT_ERROR;
+	}
+	buildWaitTable(plan->scratchTable, n, slices, plan->waitTable);
+
+	// a detour through another stop may beat the direct walk (see closure.c)
+	closePlanWalks(plan);
+
+	// Priorities is by row like RideMatrix, every attraction is worth 1 without it
+	cJSON *priorities = cJSON_GetObjectItemCaseSensitive(json, "Priorities");
+	for (int i = 0; i < n; i++) {
+		cJSON *priority = cJSON_GetArrayItem(priorities, i);
+		plan->priority[i] = cJSON_IsNumber(priority) ? priority->valueint : 1;
+	}
+	plan->priority[0] = 0;
+	plan->priority[n - 1] = 0;
+
+	// only used to pick one tour off a Pareto front
+	plan->walkingWeight = readDouble(json, "WalkingWeight", 1);
+	plan->waitingWeight = readDouble(json, "WaitingWeight", 1);
+
+	// StartingArray is in label space, without it the key order is the tour
+	cJSON *startingArray = cJSON_GetObjectItemCaseSensitive(json, "StartingArray");
+	if (cJSON_GetArraySize(startingArray) == n) {
+		int labels[MAX_ROWS];
+		j = 0;
+		cJSON_ArrayForEach(item, startingArray) {
+			labels[j++] = parseLabel(item);
+		}
+		labelsToTour(plan, labels, plan->startTour);
+	} else {
+		for (int i = 0; i < n; i++) {
+			plan->startTour[i] = i;
+		}
+	}
+
+	if (loadFastPass(json, plan) != 0 || loadScenarios(json, plan) != 0) {
+		return RESULT_ERROR;
+	}
+	detectSymmetry(plan);
+	return 0;
+}
+
+/* copies everything the solvers need out of the json and precomputes the wait
+   tables. Returns 0, or RESULT_ERROR after printing what was wrong */
+int loadPlan(const cJSON *json, struct Plan *plan) {
+	memset(plan, 0, sizeof(struct Plan));
+	if (readPlan(json, plan) != 0) {
+		freePlan(plan);
+		return RESULT_ERROR;
+	}
+	return 0;
+}
+
+/* loadPlan into a plan that is zeroed or was loaded before, reusing its
+   tables when the new plan fits in them, so a context that loads plan after
+   plan stops allocating once it has seen the largest. The tables stay
+   allocated on RESULT_ERROR too, until freePlan() */
+int reloadPlan(const cJSON *json, struct Plan *plan) {
+	struct Plan old = *plan;
+	memset(plan, 0, sizeof(struct Plan));
+	plan->key = old.key;
+	plan->rideTime = old.rideTime;
+	plan->walk = old.walk;
+	plan->walkVia = old.walkVia;
+	plan->waitTable = old.waitTable;
+	plan->startTour = old.startTour;
+	plan->priority = old.priority;
+	plan->returnTable = old.returnTable;
+	plan->passGroup = old.passGroup;
+	plan->passFixed = old.passFixed;
+	plan->scenarioTable = old.scenarioTable;
+	plan->scratchTable = old.scratchTable;
+	plan->rowCapacity = old.rowCapacity;
+	plan->sliceCapacity = old.sliceCapacity;
+	return readPlan(json, plan);
+}
+
+// frees what allocPlan allocated
+void freePlan(struct Plan *plan) {
+	freeTables(plan);
+	memset(plan, 0, sizeof(struct Plan));
+}
+
+/* looks up a precomputed wait table at a time of day. Times outside the
+   matrix use the first or last slice */
+int tableAt(const struct Plan *plan, const int *table, int row, int time) {
+	int s = (time - plan->matrixStart) / plan->segment;
+	if (s < 0) {
+		s = 0;
+	} else if (s >= plan->numSlices) {
+		s = plan->numSlices - 1;
+	}
+	return table[row * plan->numSlices + s];
+}
+
+/* recomputes the timeline of a tour of "length" stops from position "from"
+   on, using the time the guest left position from - 1. offTimes[i] is when
+   the guest gets off the attraction at position i, the last entry is the
+   arrival back at the entrance. Tours shorter than the plan are routes that
+   skip some attractions. Returns the total time of the tour */
+int rescheduleRoute(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, int *offTimes, int from) {
+	int n = plan->length;
+	int off_time = offTimes[from - 1];
+
+	for (int i = from; i < length - 1; i++) {
+		int row = tour[i];
+		int arrival_time = off_time + plan->walk[tour[i - 1] * n + row];
+		const int *table = (usePass != NULL && usePass[row]) ? plan->returnTable : plan->waitTable;
+		off_time = arrival_time + tableAt(plan, table, row, arrival_time) + plan->rideTime[row];
+		offTimes[i] = off_time;
+	}
+
+	// walk back to the entrance
+	offTimes[length - 1] = off_time + plan->walk[tour[length - 2] * n + tour[length - 1]];
+	return offTimes[length - 1] - offTimes[0];
+}
+
+// recomputes the timeline of a full length tour from position "from" on
+int rescheduleFrom(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes, int from) {
+	return rescheduleRoute(plan, tour, plan->length, usePass, offTimes, from);
+}
+
+// computes the whole timeline of a tour (through the plan's length kernel if it has one), returns total time
+int scheduleTour(const struct Plan *plan, const int *tour, const unsigned char *usePass, int *offTimes) {
+	int scratch[MAX_ROWS];
+	if (offTimes == NULL) {
+		offTimes = scratch;
+	}
+	if (plan->kernels != NULL) {
+		return plan->kernels->schedule(plan, tour, usePass, offTimes);
+	}
+	offTimes[0] = plan->startTime;
+	return rescheduleFrom(plan, tour, usePass, offTimes, 1);
+}
+
+// walking minutes of a tour, like getCost() but on plan rows
+int walkingCost(const struct Plan *plan, const int *tour, int length) {
+	int n = plan->length;
+	if (length == n && plan->kernels != NULL) {
+		return plan->kernels->walkCost(plan->walk, tour);
+	}
+
+	int cost = 0;
+	for (int i = 0; i < length - 1; i++) {
+		cost += plan->walk[tour[i] * n + tour[i + 1]];
+	}
+	return cost;
+}
+
+/* scores a changed tour of "length" stops against the timeline of the
+   current one. Positions before "from" are unchanged, and from "sameFrom" on
+   the two tours visit the same rows with the same passes, so once the new
+   timeline lands on the same time as the old one the rest of the day is
+   identical and the old total is returned without walking the rest of the
+   tour. trialTimes gets the new times for from .. the position where the
+   timelines met (or the end). Touches nothing but its arguments, so worker
+   threads can call it */
+int suffixCost(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom) {
+	int n = plan->length;
+	int off_time = offTimes[from - 1];
+
+	for (int i = from; i < length - 1; i++) {
+		int row = tour[i];
+		int arrival_time = off_time + plan->walk[tour[i - 1] * n + row];
+		const int *table = (usePass != NULL && usePass[row]) ? plan->returnTable : plan->waitTable;
+		off_time = arrival_time + tableAt(plan, table, row, arrival_time) + plan->rideTime[row];
+		trialTimes[i] = off_time;
+
+		if (i >= sameFrom && off_time == offTimes[i]) {
+			return offTimes[length - 1] - offTimes[0];
+		}
+	}
+
+	trialTimes[length - 1] = off_time + plan->walk[tour[length - 2] * n + tour[length - 1]];
+	return trialTimes[length - 1] - offTimes[0];
+}
+
+// suffixCost() counted as one scored move in planMetrics
+int evaluateRouteSuffix(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom) {
+	planMetrics.movesEvaluated++;
+	return suffixCost(plan, tour, length, usePass, offTimes, trialTimes, from, sameFrom);
+}
+
+// evaluateRouteSuffix for a tour of the full plan length
+int evaluateSuffix(const struct Plan *plan, const int *tour, const unsigned char *usePass, const int *offTimes, int *trialTimes, int from, int sameFrom) {
+	return evaluateRouteSuffix(plan, tour, plan->length, usePass, offTimes, trialTimes, from, sameFrom);
+}
+
+/* prints arrival, mount and dismount times of a tour of "length" stops and
+   warns when it runs past park close */
+void printSchedule(const struct Plan *plan, const int *tour, int length, const unsigned char *usePass) {
+	int n = plan->length;
+
+	char* startTimeStr = clockTime(plan->startTime);
+	printf("Start Time: %s\n", startTimeStr);
+	free(startTimeStr);
+
+	int off_time = plan->startTime;
+	for (int i = 1; i < length - 1; i++) {
+		int row = tour[i];
+		bool pass = usePass != NULL && usePass[row];
+
+		int passed[MAX_ROWS];
+		int numPassed = walkPath(plan, tour[i - 1], row, passed);
+		if (numPassed > 0) {
+			printf("\nWalks past");
+			for (int k = 0; k < numPassed; k++) {
+				printf(" %d", plan->key[passed[k]]);
+			}
+			printf("\n");
+		}
+
+		int arrival_time = off_time + plan->walk[tour[i - 1] * n + row];
+		char* arrivalTimeStr = clockTime(arrival_time);
+		printf("\nArrives at %d: %s%s\n", plan->key[row], arrivalTimeStr, pass ? " (return-time pass)" : "");
+		free(arrivalTimeStr);
+
+		int mount_time = arrival_time + tableAt(plan, pass ? plan->returnTable : plan->waitTable, row, arrival_time);
+		char* mountTimeStr = clockTime(mount_time);
+		printf("Mounts attraction at %s\n", mountTimeStr);
+		free(mountTimeStr);
+
+		off_time = mount_time + plan->rideTime[row];
+		char* getTimeStr = clockTime(off_time);
+		printf("Gets off attraction at %s\n", getTimeStr);
+		free(getTimeStr);
+	}
+
+	int end_time = off_time + plan->walk[tour[length - 2] * n + tour[length - 1]];
+	char* finish_time = clockTime(end_time);
+	printf("\nArrives back to park entrance at %s\n", finish_time);
+	free(finish_time);
+
+	printf("\nTotal time: %d\n", end_time - plan->startTime);
+
+	if (end_time > plan->stopTime) {
+		printf("Warning: runs %d minutes past park close\n", end_time - plan->stopTime);
+	}
+}
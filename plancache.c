@@ -0,0 +1,331 @@
+// plancache.c
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* first bytes of a cache file, and the layout version after them */
+#define CACHE_MAGIC "PLANCACH"
+#define CACHE_VERSION 1
+
+/* slots tried after a plan's home slot before the home slot is overwritten */
+#define CACHE_PROBES 4
+
+/* times a reader retries an entry a writer is in the middle of */
+#define READ_RETRIES 4
+
+/*............................................................................*/
+
+/* Plan Cache Functions:
+	1. planFingerprint -> canonical hash of everything a solve depends on
+	2. openPlanCache -> maps a cache file, creating it if it doesn't exist
+	3. closePlanCache -> unmaps and closes it
+	4. readEntry -> copies one entry out under its sequence number
+	5. lookupPlan -> the cached tour of a fingerprint, if there is one
+	6. storePlan -> caches a solved tour, keeping the shorter of two
+	7. restoreTour -> turns a cached tour back into rows and passes of a
+	   plan
+
+   Many guests send the same request: the same attractions, start, visit
+   date and weights. The fingerprint hashes exactly what a solve reads -
+   the times of day, weights, pass limits, and for every attraction in
+   label order its ride, priority, pass group, wait and return tables and
+   its walks to the others - so the same request hashes the same whatever
+   order its attractions were listed in. The wait tables are part of it,
+   so when a park's wait data changes every old entry stops matching and
+   is overwritten in time; nothing has to be flushed.
+
+   The cache is a file of fixed-size entries mapped shared into every
+   solver process, an open-addressed and lossy table like the tour cache
+   of tabu.c: a fingerprint lives in its home slot or one of the next
+   CACHE_PROBES - 1, and when they are all taken the home slot is
+   overwritten. Readers never lock. Each entry has a sequence number that
+   is odd while a writer is in it: a reader copies the entry and keeps the
+   copy only if the number was even and unchanged around the copy, and a
+   writer claims the entry by bumping the number with a compare and swap,
+   skipping the store if another writer got there first, and fences
+   before writing so no write shows before the odd number. A hit is a probe
+   of a few cache lines plus one copy, and the tour is checked against the
+   plan before it is used. */
+
+
+// one cached tour, a power of two of them follow the file header
+struct CachedPlan {
+	unsigned int sequence;      // odd while a writer is in the entry
+	int cost;                   // total time of the tour
+	unsigned long long fingerprint;     // 0 marks an empty entry
+	int length;
+	int labels[MAX_ROWS];       // the tour as attraction labels
+	unsigned char passes[MAX_ROWS];     // 1 where the stop rides with a pass
+};
+
+// the start of a cache file
+struct CacheHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int bits;          // 2^bits entries
+	unsigned int entrySize;     // sizeof(struct CachedPlan) of the writer
+	unsigned int maxRows;       // MAX_ROWS of the writer
+	char padding[40];           // entries start on a cache line
+};
+
+// folds one int into an FNV-1a hash
+static unsigned long long mixInt(unsigned long long hash, int value) {
+	return fnvInts(hash, &value, 1);
+}
+
+// folds the bits of a double into an FNV-1a hash
+static unsigned long long mixDouble(unsigned long long hash, double value) {
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	hash = mixInt(hash, (int)(bits & 0xFFFFFFFF));
+	return mixInt(hash, (int)(bits >> 32));
+}
+
+/* canonical hash of a plan as solver "solver" sees it: the day, weights and
+   pass limits, and every attraction's data in label order, so the order
+   AttractionsToInclude lists them in doesn't matter. Never 0 */
+unsigned long long planFingerprint(const struct Plan *plan, const char *solver) {
+	int n = plan->length;
+	int slices = plan->numSlices;
+	int order[MAX_ROWS];
+	unsigned long long hash = FNV_OFFSET;
+
+	for (const char *c = solver; *c != '\0'; c++) {
+		hash = mixInt(hash, *c);
+	}
+
+	// rows by label, entrance at both ends
+	order[0] = 0;
+	order[n - 1] = n - 1;
+	for (int i = 1; i < n - 1; i++) {
+		int j = i;
+		while (j > 1 && plan->key[order[j - 1]] > plan->key[i]) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	hash = mixInt(hash, n);
+	hash = mixInt(hash, slices);
+	hash = mixInt(hash, plan->segment);
+	hash = mixInt(hash, plan->startTime);
+	hash = mixInt(hash, plan->stopTime);
+	hash = mixInt(hash, plan->matrixStart);
+	hash = mixDouble(hash, plan->walkingWeight);
+	hash = mixDouble(hash, plan->waitingWeight);
+	hash = mixInt(hash, plan->forcePasses);
+	hash = mixInt(hash, plan->numGroups);
+	for (int g = 0; g < plan->numGroups; g++) {
+		hash = mixInt(hash, plan->groupLimit[g]);
+	}
+
+	for (int i = 0; i < n; i++) {
+		int row = order[i];
+		hash = mixInt(hash, plan->key[row]);
+		hash = mixInt(hash, plan->rideTime[row]);
+		hash = mixInt(hash, plan->priority[row]);
+		hash = mixInt(hash, plan->passGroup[row]);
+		hash = mixInt(hash, plan->passFixed[row]);
+		for (int s = 0; s < slices; s++) {
+			hash = mixInt(hash, plan->waitTable[row * slices + s]);
+			hash = mixInt(hash, plan->returnTable[row * slices + s]);
+		}
+		for (int j = 0; j < n; j++) {
+			hash = mixInt(hash, plan->walk[row * n + order[j]]);
+		}
+	}
+	return hash != 0 ? hash : 1;
+}
+
+/* maps the cache file at path into memory, creating it with 2^bits entries
+   if it doesn't exist. An existing file keeps its own size. Returns 0, or
+   RESULT_ERROR if the file can't be opened or was written by a build with
+   a different layout */
+int openPlanCache(struct PlanCache *cache, const char *path, int bits) {
+	memset(cache, 0, sizeof(struct PlanCache));
+	cache->fd = -1;
+
+	if (bits < 1 || bits > 24) {
+		printf("Error: a plan cache has between 2^1 and 2^24 entries, not 2^%d.\n", bits);
+		return RESULT_ERROR;
+	}
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		printf("Error: can't open plan cache %s.\n", path);
+		return RESULT_ERROR;
+	}
+
+	// only one process sets up a new file
+	flock(fd, LOCK_EX);
+	struct stat info;
+	struct CacheHeader header;
+	fstat(fd, &info);
+	if (info.st_size == 0) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+		header.version = CACHE_VERSION;
+		header.bits = bits;
+		header.entrySize = sizeof(struct CachedPlan);
+		header.maxRows = MAX_ROWS;
+		size_t size = sizeof(header) + ((size_t)1 << bits) * sizeof(struct CachedPlan);
+		if (ftruncate(fd, size) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+			printf("Error: can't size plan cache %s.\n", path);
+			flock(fd, LOCK_UN);
+			close(fd);
+			return RESULT_ERROR;
+		}
+		info.st_size = size;
+	} else if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+		memset(&header, 0, sizeof(header));
+	}
+	flock(fd, LOCK_UN);
+
+	size_t size = sizeof(header) + ((size_t)1 << (header.bits & 31)) * sizeof(struct CachedPlan);
+	if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != CACHE_VERSION
+		|| header.entrySize != sizeof(struct CachedPlan) || header.maxRows != MAX_ROWS || (size_t)info.st_size < size) {
+		printf("Error: %s is not a plan cache of this build.\n", path);
+		close(fd);
+		return RESULT_ERROR;
+	}
+
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		printf("Error: can't map plan cache %s.\n", path);
+		close(fd);
+		return RESULT_ERROR;
+	}
+
+	cache->fd = fd;
+	cache->size = size;
+	cache->map = map;
+	cache->mask = (1u << header.bits) - 1;
+	cache->entries = (struct CachedPlan*)((char*)map + sizeof(struct CacheHeader));
+	return 0;
+}
+
+// unmaps and closes what openPlanCache opened
+void closePlanCache(struct PlanCache *cache) {
+	if (cache->map != NULL) {
+		munmap(cache->map, cache->size);
+	}
+	if (cache->fd >= 0) {
+		close(cache->fd);
+	}
+	memset(cache, 0, sizeof(struct PlanCache));
+	cache->fd = -1;
+}
+
+/* copies entry into copy if it holds fingerprint and no writer changed it
+   during the copy. Returns 1 for a clean copy of the fingerprint */
+static int readEntry(const struct CachedPlan *entry, unsigned long long fingerprint, struct CachedPlan *copy) {
+	for (int attempt = 0; attempt < READ_RETRIES; attempt++) {
+		unsigned int before = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			continue;
+		}
+		if (__atomic_load_n(&entry->fingerprint, __ATOMIC_RELAXED) != fingerprint) {
+			return 0;
+		}
+		memcpy(copy, entry, sizeof(struct CachedPlan));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&entry->sequence, __ATOMIC_RELAXED) == before) {
+			return copy->fingerprint == fingerprint;
+		}
+	}
+	return 0;
+}
+
+/* the cached tour of fingerprint: labels gets it as attraction labels and
+   passes (optional) flags the stops that ride with a pass. Returns its
+   total time, or RESULT_ERROR on a miss */
+int lookupPlan(const struct PlanCache *cache, unsigned long long fingerprint, int *labels, unsigned char *passes) {
+	struct CachedPlan copy;
+	for (unsigned int p = 0; p < CACHE_PROBES; p++) {
+		const struct CachedPlan *entry = &cache->entries[(fingerprint + p) & cache->mask];
+		if (readEntry(entry, fingerprint, &copy) && copy.length > 0 && copy.length <= MAX_ROWS) {
+			memcpy(labels, copy.labels, copy.length * sizeof(int));
+			if (passes != NULL) {
+				memcpy(passes, copy.passes, copy.length * sizeof(unsigned char));
+			}
+			return copy.cost;
+		}
+	}
+	return RESULT_ERROR;
+}
+
+/* caches the tour of a plan with the given fingerprint (labels and passes
+   by stop, passes may be NULL), unless the same plan is cached with a
+   tour at least as short or another writer holds the slot. Returns 1 if
+   the tour was stored */
+int storePlan(struct PlanCache *cache, unsigned long long fingerprint, const int *labels, const unsigned char *passes, int length, int cost) {
+	struct CachedPlan *entry = &cache->entries[fingerprint & cache->mask];
+	for (unsigned int p = 0; p < CACHE_PROBES; p++) {
+		struct CachedPlan *slot = &cache->entries[(fingerprint + p) & cache->mask];
+		unsigned long long held = __atomic_load_n(&slot->fingerprint, __ATOMIC_RELAXED);
+		if (held == fingerprint && __atomic_load_n(&slot->cost, __ATOMIC_RELAXED) <= cost) {
+			return 0;
+		}
+		if (held == 0 || held == fingerprint) {
+			entry = slot;
+			break;
+		}
+	}
+
+	unsigned int sequence = __atomic_load_n(&entry->sequence, __ATOMIC_RELAXED);
+	if ((sequence & 1) || !__atomic_compare_exchange_n(&entry->sequence, &sequence, sequence + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return 0;
+	}
+	// the odd sequence must be visible before any of the writes below
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	entry->cost = cost;
+	entry->length = length;
+	memcpy(entry->labels, labels, length * sizeof(int));
+	if (passes != NULL) {
+		memcpy(entry->passes, passes, length * sizeof(unsigned char));
+	} else {
+		memset(entry->passes, 0, length * sizeof(unsigned char));
+	}
+	__atomic_store_n(&entry->fingerprint, fingerprint, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->sequence, sequence + 2, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/* turns a cached tour (labels and passes by stop) back into rows of plan in
+   tour and passes by row in usePass (optional), and checks that it still
+   takes cost minutes. Returns cost, or RESULT_ERROR if it doesn't fit the
+   plan */
+int restoreTour(const struct Plan *plan, const int *labels, const unsigned char *passes, int cost, int *tour, unsigned char *usePass) {
+	int n = plan->length;
+	unsigned char seen[MAX_ROWS] = {0};
+
+	labelsToTour(plan, labels, tour);
+	for (int i = 1; i < n - 1; i++) {
+		if (tour[i] <= 0 || seen[tour[i]]) {
+			return RESULT_ERROR;
+		}
+		seen[tour[i]] = 1;
+	}
+	if (usePass != NULL) {
+		memset(usePass, 0, n * sizeof(unsigned char));
+		for (int i = 1; i < n - 1; i++) {
+			usePass[tour[i]] = passes[i];
+		}
+	}
+	return scheduleTour(plan, tour, usePass, NULL) == cost ? cost : RESULT_ERROR;
+}
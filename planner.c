@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "functions.h"
+
+
+/* How to use:
+    ./planner [mode] [plan file] [objective]
+
+    modes:
+        fastpass -> optimizes visit order and return-time passes together
+        anytime -> the fastpass search against a deadline, the third argument
+                  is the time budget in milliseconds (default 100), prints
+                  the convergence trace
+        robust -> optimizes visit order against every wait scenario at once,
+                  objective is expected (default), worst or p90 style percentile
+        orienteer -> visits the most valuable attractions that fit before park
+                  close, an optional third argument moves close earlier
+                  (minutes since midnight)
+        tabu -> tabu search over visit order with a cache of scored tours,
+                  for plans where plain reversals get stuck
+        vnd -> descends through relocate, swap, or-opt and 2-opt moves
+                  until none of them shortens the day
+        memetic -> evolves a population of tours on every core, the third
+                  argument is the number of generations (default 50)
+        pareto -> the tours no other tour beats on walking, waiting and day
+                  length at once, prints the front and the schedule of the
+                  one WalkingWeight and WaitingWeight prefer
+        portfolio -> races every solver on its own thread, the third
+                  argument is the deadline in milliseconds (default 1000),
+                  prints how each solver did
+        simulate -> finds the shortest days by tabu search, simulates each
+                  over sampled waits (the third argument is the number of
+                  samples, default 10000) and ranks them by their 90th
+                  percentile finish, with the chance of running past Stop
+        replan -> follows the starting tour halfway, runs 20 minutes late,
+                  finds the lines running 25% longer than forecast and
+                  replans the rest of the day from there
+
+    the plan file defaults to useCase.json
+
+    after every plan the phase timings and solver counters are printed as
+    json, or in prometheus text format with PLANNER_METRICS=prometheus
+    (PLANNER_METRICS=off turns them off)
+
+    fastpass, anytime, tabu, vnd, memetic and portfolio also print a lower
+    bound on the day and the gap of their answer to it. With PLANNER_STOP_GAP=<percent>
+    they stop as soon as their tour is within that percent of the bound
+
+    with PLANNER_ALTERNATIVES=<k> tabu, memetic and portfolio also print the
+    k shortest distinct days they scored (k at most 16), each with its order,
+    and simulate ranks k tours instead of 16
+
+    with PLANNER_CACHE=<file> fastpass keeps its answers in that cache file
+    (created if missing) and answers a plan solved before straight from it,
+    across runs and processes
+*/
+
+// 2^PLAN_CACHE_BITS plans in a cache file the planner creates
+#define PLAN_CACHE_BITS 14
+
+// standby waits the replan mode sees, in percent of the forecast
+#define REPLAN_WAIT_PERCENT 125
+
+// prints which attractions ride with a pass
+static void printPasses(const struct Plan *plan, const int *tour, const unsigned char *usePass) {
+    int passes = 0;
+    printf("Return-time passes: ");
+    for (int i = 1; i < plan->length - 1; i++) {
+        if (usePass[tour[i]]) {
+            printf("%d ", plan->key[tour[i]]);
+            passes++;
+        }
+    }
+    if (passes == 0) {
+        printf("none");
+    }
+    printf("\n");
+}
+
+/* lower bound on the day, counted in the metrics. With PLANNER_STOP_GAP set
+   the solvers stop once they are within that percent of it */
+static void boundDay(struct Plan *plan, int usePasses) {
+    char *stopGap = getenv("PLANNER_STOP_GAP");
+    planMetrics.lowerBound = dayBound(plan, usePasses, scheduleTour(plan, plan->startTour, NULL, NULL));
+    stopAtGap(plan, planMetrics.lowerBound, stopGap != NULL ? atof(stopGap) : -1);
+}
+
+// prints the bound and how far over optimal the best tour can be at most
+static void printGap(int best_cost) {
+    planMetrics.bestCost = best_cost;
+    printf("Lower bound: %d minutes, at most %0.2f%% over optimal\n", planMetrics.lowerBound, optimalityGap(best_cost, planMetrics.lowerBound));
+}
+
+// prints the shortest days the solver offered to plan->alternatives, standby waits only
+static void printAlternatives(const struct Plan *plan) {
+    struct BestTours *best = plan->alternatives;
+    int labels[MAX_ROWS];
+
+    sortBestTours(plan, best, NULL);
+    printf("%d shortest days found (minutes, back at the entrance, order):\n", best->size);
+    for (int i = 0; i < best->size; i++) {
+        char* finishStr = clockTime(best->offTimes[i][plan->length - 1]);
+        tourToLabels(plan, best->tours[i], labels);
+        printf("%5d  %s  ", best->cost[i], finishStr);
+        printArray(labels, plan->length);
+        printf("\n");
+        free(finishStr);
+    }
+}
+
+/* optimizes visit order and return-time passes together. With a plan cache
+   a request solved before is answered from it, and a new one is stored */
+static int runFastPass(struct Plan *plan, struct PlanCache *cache) {
+    int tour[MAX_ROWS], labels[MAX_ROWS];
+    unsigned char usePass[MAX_ROWS], passes[MAX_ROWS];
+    int groupUsed[MAX_PASS_GROUPS];
+    unsigned long long fingerprint = 0;
+    int best_cost = -1;
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+
+    int standby_cost = scheduleTour(plan, tour, NULL, NULL);
+    printf("Total time of starting tour without passes: %d minutes\n", standby_cost);
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 1);
+    if (cache != NULL) {
+        fingerprint = planFingerprint(plan, "fastpass");
+        int cost = lookupPlan(cache, fingerprint, labels, passes);
+        if (cost >= 0) {
+            best_cost = restoreTour(plan, labels, passes, cost, tour, usePass);
+        }
+    }
+    if (best_cost < 0) {
+        memcpy(tour, plan->startTour, plan->length * sizeof(int));
+        initPasses(plan, tour, usePass, groupUsed);
+        best_cost = optimizeWithPasses(plan, tour, usePass, 1000 * plan->length);
+        if (cache != NULL) {
+            tourToLabels(plan, tour, labels);
+            for (int i = 0; i < plan->length; i++) {
+                passes[i] = usePass[tour[i]];
+            }
+            storePlan(cache, fingerprint, labels, passes, plan->length, best_cost);
+        }
+    } else {
+        printf("Answered from the plan cache (fingerprint %016llx)\n", fingerprint);
+    }
+    endPhase(PHASE_SOLVE);
+
+    printf("Total time after optimizing order and passes: %d minutes - %0.2f hours\n", best_cost, ((float)best_cost) / 60);
+    printGap(best_cost);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+    printPasses(plan, tour, usePass);
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, tour, plan->length, usePass);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+// the fastpass search against a wall-clock deadline
+static int runAnytime(struct Plan *plan, const char *budget) {
+    int tour[MAX_ROWS], labels[MAX_ROWS];
+    unsigned char usePass[MAX_ROWS];
+    int groupUsed[MAX_PASS_GROUPS];
+    int deadlineMs = budget != NULL ? atoi(budget) : 100;
+    struct Trace trace;
+
+    if (deadlineMs <= 0) {
+        printf("Time budget must be a positive number of milliseconds: %s\n", budget);
+        return 1;
+    }
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 1);
+    initPasses(plan, tour, usePass, groupUsed);
+    int best_cost = optimizeUntil(plan, tour, usePass, deadlineMs, &trace);
+    endPhase(PHASE_SOLVE);
+
+    printf("Total time after %d ms: %d minutes - %0.2f hours\n", deadlineMs, best_cost, ((float)best_cost) / 60);
+    printGap(best_cost);
+    printf("Convergence trace [ms, minutes]: ");
+    printTraceJson(stdout, &trace);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+    printPasses(plan, tour, usePass);
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, tour, plan->length, usePass);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+// tabu search over visit order, standby waits only
+static int runTabu(struct Plan *plan) {
+    int tour[MAX_ROWS], labels[MAX_ROWS];
+    struct TourCache cache;
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    printf("Total time of starting tour: %d minutes\n", scheduleTour(plan, tour, NULL, NULL));
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 0);
+    initTourCache(&cache, plan, 16);
+    int best_cost = optimizeTabu(plan, tour, NULL, 200 * plan->length, &cache);
+    freeTourCache(&cache);
+    endPhase(PHASE_SOLVE);
+
+    printf("Total time after tabu search: %d minutes - %0.2f hours\n", best_cost, ((float)best_cost) / 60);
+    printGap(best_cost);
+    printf("Tours scored from the cache: %ld of %ld\n", planMetrics.cacheHits, planMetrics.cacheHits + planMetrics.movesEvaluated);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, tour, plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+// variable neighbourhood descent over visit order, standby waits only
+static int runVnd(struct Plan *plan) {
+    int tour[MAX_ROWS], labels[MAX_ROWS];
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    printf("Total time of starting tour: %d minutes\n", scheduleTour(plan, tour, NULL, NULL));
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 0);
+    int best_cost = optimizeVnd(plan, tour, NULL);
+    endPhase(PHASE_SOLVE);
+
+    printf("Total time after neighbourhood descent: %d minutes - %0.2f hours\n", best_cost, ((float)best_cost) / 60);
+    printGap(best_cost);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, tour, plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+// memetic search over visit order on every core, standby waits only
+static int runMemetic(struct Plan *plan, const char *generationsArg) {
+    int tour[MAX_ROWS], labels[MAX_ROWS];
+    int generations = generationsArg != NULL ? atoi(generationsArg) : 50;
+
+    if (generations <= 0) {
+        printf("Generations must be a positive number: %s\n", generationsArg);
+        return 1;
+    }
+
+    printf("Total time of starting tour: %d minutes\n", scheduleTour(plan, plan->startTour, NULL, NULL));
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 0);
+    int best_cost = optimizeMemetic(plan, tour, generations, 0, (unsigned int)time(NULL));
+    endPhase(PHASE_SOLVE);
+
+    printf("Total time after %d generations: %d minutes - %0.2f hours\n", generations, best_cost, ((float)best_cost) / 60);
+    printGap(best_cost);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, tour, plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+// the non-dominated tours over walking, waiting and day length, standby waits only
+static int runPareto(const struct Plan *plan) {
+    int labels[MAX_ROWS];
+    struct ParetoFront *front = (struct ParetoFront*)malloc(sizeof(struct ParetoFront));
+
+    startPhase(PHASE_SOLVE);
+    solvePareto(plan, front, 2000 * plan->length);
+    endPhase(PHASE_SOLVE);
+    int preferred = preferredTour(plan, front);
+
+    // by walking, which also orders the front by waiting the other way
+    for (int a = 1; a < front->size; a++) {
+        for (int b = a; b > 0 && front->walking[b] < front->walking[b - 1]; b--) {
+            swap(&front->walking[b], &front->walking[b - 1]);
+            swap(&front->waiting[b], &front->waiting[b - 1]);
+            swap(&front->total[b], &front->total[b - 1]);
+            for (int i = 0; i < plan->length; i++) {
+                swap(&front->tours[b][i], &front->tours[b - 1][i]);
+            }
+            preferred = preferred == b ? b - 1 : (preferred == b - 1 ? b : preferred);
+        }
+    }
+
+    printf("%d tours on the front (walking, waiting, total minutes):\n", front->size);
+    for (int a = 0; a < front->size; a++) {
+        printf("%s %4d %5d %5d  ", a == preferred ? "*" : " ", front->walking[a], front->waiting[a], front->total[a]);
+        tourToLabels(plan, front->tours[a], labels);
+        printArray(labels, plan->length);
+        printf("\n");
+    }
+    planMetrics.bestCost = front->total[preferred];
+
+    printf("\nPreferred with WalkingWeight %.2f and WaitingWeight %.2f: ", plan->walkingWeight, plan->waitingWeight);
+    tourToLabels(plan, front->tours[preferred], labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, front->tours[preferred], plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    free(front);
+    return 0;
+}
+
+// races every solver over visit order on its own thread, standby waits only
+static int runPortfolio(struct Plan *plan, const char *deadlineArg) {
+    int labels[MAX_ROWS];
+    int deadlineMs = deadlineArg != NULL ? atoi(deadlineArg) : 1000;
+    struct Portfolio portfolio;
+
+    if (deadlineMs <= 0) {
+        printf("Deadline must be a positive number of milliseconds: %s\n", deadlineArg);
+        return 1;
+    }
+
+    printf("Total time of starting tour: %d minutes\n", scheduleTour(plan, plan->startTour, NULL, NULL));
+
+    startPhase(PHASE_SOLVE);
+    boundDay(plan, 0);
+    int best_cost = solvePortfolio(plan, deadlineMs, &portfolio);
+    endPhase(PHASE_SOLVE);
+
+    for (int s = 0; s < portfolio.numStrategies; s++) {
+        const struct StrategyStats *stats = &portfolio.stats[s];
+        printf("%-9s %s %5d minutes, %9ld moves, best after %8.3f of %8.3f ms\n", stats->name, s == portfolio.winner ? "*" : " ",
+            stats->cost, stats->movesEvaluated, stats->timeToBest * 1000, stats->seconds * 1000);
+    }
+    printf("Total time after the portfolio race: %d minutes - %0.2f hours%s\n", best_cost, ((float)best_cost) / 60,
+        portfolio.proven ? " (optimal)" : "");
+    printGap(best_cost);
+
+    printf("\nMost Optimal Tour: ");
+    tourToLabels(plan, portfolio.tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, portfolio.tour, plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+/* the shortest days found by tabu search, re-ranked by how late they finish
+   over sampled waits, standby waits only */
+static int runSimulate(struct Plan *plan, const char *samplesArg) {
+    int samples = samplesArg != NULL ? atoi(samplesArg) : 10000;
+    int tour[MAX_ROWS], labels[MAX_ROWS], order[MAX_BEST];
+    struct Simulation results[MAX_BEST];
+    struct TourCache cache;
+
+    if (samples <= 0) {
+        printf("Samples must be a positive number: %s\n", samplesArg);
+        return 1;
+    }
+
+    // the candidates go to PLANNER_ALTERNATIVES if it is set
+    struct BestTours *own = NULL;
+    if (plan->alternatives == NULL) {
+        own = (struct BestTours*)malloc(sizeof(struct BestTours));
+        initBestTours(own, MAX_BEST);
+        plan->alternatives = own;
+    }
+    struct BestTours *best = plan->alternatives;
+
+    startPhase(PHASE_SOLVE);
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    initTourCache(&cache, plan, 16);
+    int best_cost = optimizeTabu(plan, tour, NULL, 200 * plan->length, &cache);
+    freeTourCache(&cache);
+    sortBestTours(plan, best, NULL);
+
+    double started = wallClock();
+    rerankTours(plan, best, samples, 0, (unsigned int)time(NULL), 90, results, order);
+    double seconds = wallClock() - started;
+    endPhase(PHASE_SOLVE);
+    planMetrics.bestCost = best_cost;
+
+    printf("%d tours, %d sampled timelines each in %.1f ms (mean, p50, p90, p99 back at the entrance, past Stop, minutes, order):\n",
+        best->size, results[0].samples, seconds * 1000);
+    for (int i = 0; i < best->size; i++) {
+        const struct Simulation *result = &results[order[i]];
+        char* meanStr = clockTime((int)(result->meanFinish + 0.5));
+        char* p50Str = clockTime(result->p50);
+        char* p90Str = clockTime(result->p90);
+        char* p99Str = clockTime(result->p99);
+        tourToLabels(plan, best->tours[order[i]], labels);
+        printf("%s  %s  %s  %s  %5.1f%%  %4d  ", meanStr, p50Str, p90Str, p99Str, result->overrun * 100, best->cost[order[i]]);
+        printArray(labels, plan->length);
+        printf("\n");
+        free(meanStr);
+        free(p50Str);
+        free(p90Str);
+        free(p99Str);
+    }
+
+    printf("\nMost Robust Tour: ");
+    tourToLabels(plan, best->tours[order[0]], labels);
+    printArray(labels, plan->length);
+    printf("\n");
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, best->tours[order[0]], plan->length, NULL);
+    endPhase(PHASE_SCHEDULE);
+
+    if (own != NULL) {
+        plan->alternatives = NULL;
+        free(own);
+    }
+    return 0;
+}
+
+// optimizes visit order against every wait scenario at once
+static int runRobust(const struct Plan *plan, const char *objectiveName) {
+    int tour[MAX_ROWS], labels[MAX_ROWS], totals[SCENARIO_LANES];
+    int objective = OBJECTIVE_EXPECTED;
+    int percentile = 0;
+
+    if (strcmp(objectiveName, "worst") == 0) {
+        objective = OBJECTIVE_WORST;
+    } else if (objectiveName[0] == 'p') {
+        objective = OBJECTIVE_PERCENTILE;
+        percentile = atoi(objectiveName + 1);
+    } else if (strcmp(objectiveName, "expected") != 0) {
+        printf("Unknown objective: %s\n", objectiveName);
+        return 1;
+    }
+
+    memcpy(tour, plan->startTour, plan->length * sizeof(int));
+    printf("Wait scenarios: %d\n", plan->numScenarios);
+
+    double start_score = evaluateScenarios(plan, tour, NULL, objective, percentile, NULL);
+    startPhase(PHASE_SOLVE);
+    double best_score = optimizeRobust(plan, tour, NULL, objective, percentile, 1000 * plan->length);
+    endPhase(PHASE_SOLVE);
+    printf("Score of starting tour: %0.1f minutes\n", start_score);
+    printf("Score after robust optimization (%s): %0.1f minutes\n", objectiveName, best_score);
+
+    evaluateScenarios(plan, tour, NULL, objective, percentile, totals);
+    printf("Total time per scenario: ");
+    printArray(totals, plan->numScenarios);
+
+    printf("\n\nMost Optimal Tour: ");
+    tourToLabels(plan, tour, labels);
+    printArray(labels, plan->length);
+    printf("\n");
+    return 0;
+}
+
+// follows the starting tour halfway, runs late and replans the rest of the day
+static int runReplan(struct Plan *plan) {
+    int n = plan->length;
+    int offTimes[MAX_ROWS], labels[MAX_ROWS];
+    unsigned char visited[MAX_ROWS] = {0};
+    struct Replan replan;
+
+    scheduleTour(plan, plan->startTour, NULL, offTimes);
+
+    int current = (n - 1) / 2;
+    for (int i = 1; i <= current; i++) {
+        visited[plan->startTour[i]] = 1;
+    }
+    int currentRow = plan->startTour[current];
+    int currentTime = offTimes[current] + 20;
+
+    char* currentTimeStr = clockTime(currentTime);
+    printf("Guest is at %d at %s with %d stops left\n", plan->key[currentRow], currentTimeStr, n - 2 - current);
+    free(currentTimeStr);
+
+    // the lines as the park reports them now, longer than the forecast
+    int cells = n * plan->numSlices;
+    int *waitMatrix = (int*)malloc(cells * sizeof(int));
+    for (int c = 0; c < cells; c++) {
+        waitMatrix[c] = plan->waitTable[c] * REPLAN_WAIT_PERCENT / 100;
+    }
+    updateWaits(plan, waitMatrix);
+    free(waitMatrix);
+    printf("Standby waits are running at %d%% of the forecast\n", REPLAN_WAIT_PERCENT);
+
+    startPhase(PHASE_SOLVE);
+    int finish = replanTour(plan, plan->startTour, visited, currentRow, currentTime, NULL, 100000, &replan);
+    endPhase(PHASE_SOLVE);
+    if (finish < 0) {
+        return 1;
+    }
+
+    char* finishStr = clockTime(finish);
+    printf("Back at the entrance at %s after replanning (%f seconds)\n", finishStr, planMetrics.phaseSeconds[PHASE_SOLVE]);
+    free(finishStr);
+
+    printf("\nReplanned Tour: ");
+    tourToLabels(plan, replan.tour, labels);
+    printArray(labels, n);
+    printf("\n");
+    return 0;
+}
+
+// visits the most valuable attractions that fit before park close
+static int runOrienteer(struct Plan *plan, const char *closeTime) {
+    struct Route route;
+    int labels[MAX_ROWS];
+
+    // the close time can only move earlier, and must leave some of the day
+    if (closeTime != NULL) {
+        int close = atoi(closeTime);
+        if (close <= plan->startTime || close >= plan->stopTime) {
+            printf("Close time must be minutes since midnight between %d and %d: %s\n", plan->startTime, plan->stopTime, closeTime);
+            return 1;
+        }
+        plan->stopTime = close;
+    }
+
+    startPhase(PHASE_SOLVE);
+    int value = solveOrienteering(plan, 200 * plan->length, &route);
+    endPhase(PHASE_SOLVE);
+
+    printf("Stops that fit before park close: %d of %d (priority %d)\n", route.length - 2, plan->length - 2, value);
+    printf("\nMost Optimal Route: ");
+    for (int i = 0; i < route.length; i++) {
+        labels[i] = plan->key[route.stops[i]];
+    }
+    printArray(labels, route.length);
+
+    printDash();
+    startPhase(PHASE_SCHEDULE);
+    printSchedule(plan, route.stops, route.length, NULL);
+    endPhase(PHASE_SCHEDULE);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    char *mode = argc > 1 ? argv[1] : "fastpass";
+    char *filename = argc > 2 ? argv[2] : "useCase.json";
+    char *metrics = getenv("PLANNER_METRICS");
+
+    resetMetrics();
+    cJSON *json = readPlanFile(filename);
+    if (json == NULL) {
+        return 1;
+    }
+
+    struct Plan plan;
+    startPhase(PHASE_MATRIX);
+    if (loadPlan(json, &plan) != 0) {
+        cJSON_Delete(json);
+        return 1;
+    }
+    cJSON_Delete(json);
+    endPhase(PHASE_MATRIX);
+
+    char *alternatives = getenv("PLANNER_ALTERNATIVES");
+    if (alternatives != NULL) {
+        plan.alternatives = (struct BestTours*)malloc(sizeof(struct BestTours));
+        if (initBestTours(plan.alternatives, atoi(alternatives)) != 0) {
+            free(plan.alternatives);
+            freePlan(&plan);
+            return 1;
+        }
+    }
+
+    struct PlanCache cache;
+    char *cachePath = getenv("PLANNER_CACHE");
+    if (cachePath != NULL && openPlanCache(&cache, cachePath, PLAN_CACHE_BITS) != 0) {
+        free(plan.alternatives);
+        freePlan(&plan);
+        return 1;
+    }
+
+    srand(time(NULL));
+
+    int result;
+    if (strcmp(mode, "fastpass") == 0) {
+        result = runFastPass(&plan, cachePath != NULL ? &cache : NULL);
+    } else if (strcmp(mode, "anytime") == 0) {
+        result = runAnytime(&plan, argc > 3 ? argv[3] : NULL);
+    } else if (strcmp(mode, "robust") == 0) {
+        result = runRobust(&plan, argc > 3 ? argv[3] : "expected");
+    } else if (strcmp(mode, "orienteer") == 0) {
+        result = runOrienteer(&plan, argc > 3 ? argv[3] : NULL);
+    } else if (strcmp(mode, "tabu") == 0) {
+        result = runTabu(&plan);
+    } else if (strcmp(mode, "vnd") == 0) {
+        result = runVnd(&plan);
+    } else if (strcmp(mode, "memetic") == 0) {
+        result = runMemetic(&plan, argc > 3 ? argv[3] : NULL);
+    } else if (strcmp(mode, "pareto") == 0) {
+        result = runPareto(&plan);
+    } else if (strcmp(mode, "portfolio") == 0) {
+        result = runPortfolio(&plan, argc > 3 ? argv[3] : NULL);
+    } else if (strcmp(mode, "simulate") == 0) {
+        result = runSimulate(&plan, argc > 3 ? argv[3] : NULL);
+    } else if (strcmp(mode, "replan") == 0) {
+        result = runReplan(&plan);
+    } else {
+        printf("Unknown mode: %s\n", mode);
+        result = 1;
+    }
+
+    if (plan.alternatives != NULL && plan.alternatives->size > 0) {
+        printDash();
+        printAlternatives(&plan);
+    }
+
+    if (metrics == NULL || strcmp(metrics, "off") != 0) {
+        printDash();
+        if (metrics != NULL && strcmp(metrics, "prometheus") == 0) {
+            printMetricsPrometheus(stdout, plan.planId);
+        } else {
+            printMetricsJson(stdout, plan.planId);
+        }
+    }
+
+    if (cachePath != NULL) {
+        closePlanCache(&cache);
+    }
+    free(plan.alternatives);
+    freePlan(&plan);
+    return result;
+}
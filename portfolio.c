@@ -0,0 +1,290 @@
+// portfolio.c
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* the strategies a race runs, the exact search only on plans it can take */
+#define STRATEGY_REVERSAL 0
+#define STRATEGY_TABU 1
+#define STRATEGY_VND 2
+#define STRATEGY_MEMETIC 3
+#define STRATEGY_EXACT 4
+#define NUM_STRATEGIES 5
+
+/* move budget of the open-ended strategies, which run until the race ends */
+#define RACE_STEPS (1 << 30)
+
+/* 2^CACHE_BITS tours in the cache of the tabu strategy */
+#define CACHE_BITS 16
+
+/*............................................................................*/
+
+/* Portfolio Functions:
+	1. keepSearching -> whether a solver should go on, publishing its best
+	   cost to its race
+	2. raceIncumbent -> the shortest day known to a solver and its race, for
+	   pruning
+	3. runStrategy -> what each thread of a race runs
+	4. solvePortfolio -> races every strategy against one deadline
+
+   Which solver does best depends on the plan: the exact search wins small
+   plans outright, the descent and tabu search are quick on mid-sized ones
+   and the memetic search wins full-park plans given time. A portfolio race
+   runs them all at once, one thread each, on the visit order with standby
+   waits, and keeps the best tour any of them finds.
+
+   The strategies share one struct Race. Every solver loop already asks
+   keepSearching() before its next move, so that call publishes the
+   solver's best cost into race->incumbent (an atomic minimum) and reports
+   whether race->over was set. The exact search prunes with the incumbent,
+   so when it runs to the end it proves the incumbent optimal. The race
+   ends at the deadline, when the exact search finishes, or as soon as any
+   strategy reaches the lower bound on the day (or plan->stopCost, if that
+   is looser). Each strategy then stops within one move, or one generation
+   for the memetic search.
+
+   Every strategy works on its own shallow copy of the plan, which shares
+   the read-only matrices. planMetrics is per thread, so each strategy's
+   counters become its stats. The strategies draw from rand(), which glibc
+   locks, so their random streams interleave and a race is not repeatable
+   the way a single solver run is. When the plan keeps alternatives each
+   strategy offers its tours to a set of its own, and the sets are merged
+   into plan->alternatives once the threads are joined. */
+
+
+// the state a race's threads share with the thread running it
+struct Track {
+	struct Race race;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;     // signalled when a strategy stops
+	int finished;               // strategies that have stopped
+	int proved;                 // 1 once the exact search ran to the end
+};
+
+// one strategy of a race and what it found
+struct Entrant {
+	struct Plan plan;           // copy of the plan in the race, passes dropped
+	int passGroup[MAX_ROWS];    // all -1, so the reversal search can't add passes
+	int strategy;
+	int deadlineMs;
+	unsigned int seed;
+	struct Track *track;
+	struct StrategyStats *stats;
+	int tour[MAX_ROWS];
+	struct BestTours alternatives;  // what the strategy offers, when the plan keeps alternatives
+};
+
+static const char *strategyNames[NUM_STRATEGIES] = {"reversal", "tabu", "vnd", "memetic", "exact"};
+
+/* true while a solver whose best tour takes "cost" should go on: the tour is
+   longer than plan->stopCost and, in a race, the race isn't over. Publishes
+   cost as the race's incumbent when it is the shortest day so far, and
+   ends the race when it is within plan->stopCost */
+int keepSearching(const struct Plan *plan, int cost) {
+	struct Race *race = plan->race;
+
+	if (race == NULL) {
+		return cost > plan->stopCost;
+	}
+
+	int incumbent = __atomic_load_n(&race->incumbent, __ATOMIC_RELAXED);
+	while (cost < incumbent && !__atomic_compare_exchange_n(&race->incumbent, &incumbent, cost, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		// incumbent was reloaded by the failed exchange
+	}
+	if (cost <= plan->stopCost) {
+		__atomic_store_n(&race->over, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	return !__atomic_load_n(&race->over, __ATOMIC_RELAXED);
+}
+
+// the shorter of cost and the shortest day the solver's race knows about
+int raceIncumbent(const struct Plan *plan, int cost) {
+	if (plan->race == NULL) {
+		return cost;
+	}
+	int incumbent = __atomic_load_n(&plan->race->incumbent, __ATOMIC_RELAXED);
+	return incumbent < cost ? incumbent : cost;
+}
+
+// runs one strategy until it stops or the race ends, then reports to the track
+static void* runStrategy(void *arg) {
+	struct Entrant *entrant = (struct Entrant*)arg;
+	const struct Plan *plan = &entrant->plan;
+	struct Track *track = entrant->track;
+	unsigned char usePass[MAX_ROWS] = {0};
+	int trial[MAX_ROWS];
+	struct TourCache cache;
+	int n = plan->length;
+	int cost = 0;
+	bool proved = false;
+
+	resetMetrics();
+	startPhase(PHASE_SOLVE);
+	memcpy(entrant->tour, plan->startTour, n * sizeof(int));
+
+	switch (entrant->strategy) {
+	case STRATEGY_REVERSAL:
+		cost = optimizeUntil(plan, entrant->tour, usePass, entrant->deadlineMs, NULL);
+		break;
+	case STRATEGY_TABU:
+		initTourCache(&cache, plan, CACHE_BITS);
+		cost = optimizeTabu(plan, entrant->tour, NULL, RACE_STEPS, &cache);
+		freeTourCache(&cache);
+		break;
+	case STRATEGY_VND:
+		// descends again from a shuffled start every time it gets stuck
+		cost = optimizeVnd(plan, entrant->tour, NULL);
+		while (keepSearching(plan, cost)) {
+			memcpy(trial, plan->startTour, n * sizeof(int));
+			shuffleArray(trial, n);
+			int trial_cost = optimizeVnd(plan, trial, NULL);
+			if (trial_cost < cost) {
+				cost = trial_cost;
+				memcpy(entrant->tour, trial, n * sizeof(int));
+			}
+		}
+		break;
+	case STRATEGY_MEMETIC:
+		cost = optimizeMemetic(plan, entrant->tour, RACE_STEPS, 1, entrant->seed);
+		break;
+	case STRATEGY_EXACT:
+		cost = solveExact(plan, NULL, entrant->tour);
+		proved = !__atomic_load_n(&track->race.over, __ATOMIC_RELAXED);
+		break;
+	}
+	endPhase(PHASE_SOLVE);
+	keepSearching(plan, cost);
+
+	entrant->stats->cost = cost;
+	entrant->stats->movesEvaluated = planMetrics.movesEvaluated;
+	entrant->stats->movesAccepted = planMetrics.movesAccepted;
+	entrant->stats->improvements = planMetrics.improvements;
+	entrant->stats->timeToBest = planMetrics.timeToBest;
+	entrant->stats->seconds = planMetrics.phaseSeconds[PHASE_SOLVE];
+
+	pthread_mutex_lock(&track->lock);
+	track->finished++;
+	if (proved) {
+		track->proved = 1;
+	}
+	pthread_cond_signal(&track->changed);
+	pthread_mutex_unlock(&track->lock);
+	return NULL;
+}
+
+/* races every strategy on its own thread for at most deadlineMs
+   milliseconds, ignoring passes. result gets the winning tour, whether it
+   is proven optimal and how each strategy did; the counters of all of them
+   are added to planMetrics and their tours offered to plan->alternatives.
+   If no thread can be started the starting tour is returned as it is.
+   Returns the total time of the winning tour */
+int solvePortfolio(const struct Plan *plan, int deadlineMs, struct Portfolio *result) {
+	struct Track track;
+	pthread_t ids[NUM_STRATEGIES];
+	int n = plan->length;
+
+	int start_cost = scheduleTour(plan, plan->startTour, NULL, NULL);
+	int bound = dayBound(plan, 0, start_cost);
+	int stop_cost = plan->stopCost > bound ? plan->stopCost : bound;
+
+	memset(result, 0, sizeof(struct Portfolio));
+	result->numStrategies = n <= MAX_EXACT_STOPS ? NUM_STRATEGIES : NUM_STRATEGIES - 1;
+	result->winner = -1;
+	result->cost = start_cost;
+	memcpy(result->tour, plan->startTour, n * sizeof(int));
+
+	memset(&track, 0, sizeof(struct Track));
+	track.race.incumbent = start_cost;
+	pthread_mutex_init(&track.lock, NULL);
+	pthread_cond_init(&track.changed, NULL);
+
+	struct Entrant *entrants = (struct Entrant*)malloc(result->numStrategies * sizeof(struct Entrant));
+	for (int s = 0; s < result->numStrategies; s++) {
+		struct Entrant *entrant = &entrants[s];
+		entrant->plan = *plan;
+		entrant->plan.race = &track.race;
+		entrant->plan.stopCost = stop_cost;
+		for (int i = 0; i < n; i++) {
+			entrant->passGroup[i] = -1;
+		}
+		entrant->plan.passGroup = entrant->passGroup;
+		entrant->plan.numGroups = 0;
+		entrant->plan.forcePasses = 0;
+		if (plan->alternatives != NULL) {
+			initBestTours(&entrant->alternatives, plan->alternatives->capacity);
+			entrant->plan.alternatives = &entrant->alternatives;
+		}
+		entrant->strategy = s;
+		entrant->deadlineMs = deadlineMs;
+		entrant->seed = (unsigned int)rand();
+		entrant->track = &track;
+		entrant->stats = &result->stats[s];
+		entrant->stats->name = strategyNames[s];
+		entrant->stats->cost = -1;
+	}
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += deadlineMs / 1000;
+	deadline.tv_nsec += (deadlineMs % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	int started = 0;
+	for (int s = 0; s < result->numStrategies; s++) {
+		if (pthread_create(&ids[s], NULL, runStrategy, &entrants[s]) != 0) {
+			printf("Warning: started %d of %d strategies.\n", started, result->numStrategies);
+			break;
+		}
+		started++;
+	}
+
+	// sleeps until the deadline, a proof, a strategy within stopCost or every strategy done
+	pthread_mutex_lock(&track.lock);
+	while (track.finished < started && !track.proved && !__atomic_load_n(&track.race.over, __ATOMIC_RELAXED)) {
+		if (pthread_cond_timedwait(&track.changed, &track.lock, &deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&track.lock);
+
+	__atomic_store_n(&track.race.over, 1, __ATOMIC_RELAXED);
+	for (int s = 0; s < started; s++) {
+		pthread_join(ids[s], NULL);
+	}
+
+	for (int s = 0; s < started; s++) {
+		struct StrategyStats *stats = &result->stats[s];
+		planMetrics.movesEvaluated += stats->movesEvaluated;
+		planMetrics.movesAccepted += stats->movesAccepted;
+		planMetrics.improvements += stats->improvements;
+		if (result->winner < 0 || stats->cost < result->cost) {
+			result->winner = s;
+			result->cost = stats->cost;
+			memcpy(result->tour, entrants[s].tour, n * sizeof(int));
+			planMetrics.timeToBest = stats->timeToBest;
+		}
+		if (plan->alternatives != NULL) {
+			mergeBestTours(plan->alternatives, &entrants[s].alternatives);
+		}
+	}
+	result->proven = track.proved || result->cost <= bound;
+
+	pthread_cond_destroy(&track.changed);
+	pthread_mutex_destroy(&track.lock);
+	free(entrants);
+	return result->cost;
+}
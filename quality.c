@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+
+/* How to use:
+    ./quality [baseline file] [save]
+
+    solves small synthetic parks (8, 10 and 12 stops, QUALITY_SEEDS of each)
+    and useCase.json exactly, then runs the heuristic solvers on the same
+    plans and measures how far from optimal they end up. Passes are dropped
+    so every solver answers the same visit order question. Prints one json
+    line per plan and one summary line per solver:
+
+    {"solver":"fastpass","runs":125,"meanGap":0.12,"medianGap":0,
+     "p90Gap":0.4,"maxGap":2.1,"optimalShare":0.91}
+
+    the solvers are the fastpass reversal search with a fixed move budget,
+    the same search against a deadline (anytime), the tabu search with
+    the same number of scored tours, the neighbourhood descent (vnd) from
+    a shuffled start, which runs until no move improves, and the memetic
+    search for MEMETIC_GENERATIONS generations. gaps are percent
+    over the optimal day. The anytime solver also reports
+    the median milliseconds its convergence trace took to get within 1% and
+    5% of optimal.
+
+    it also checks that plans gathered from a park (park.c) take only label
+    lists that start and end at the entrance and visit each attraction once,
+    and fails the run if a malformed list gets through.
+
+    with a baseline file every gap number is compared against the one stored
+    there and the run fails if any got worse by more than its tolerance (the
+    times depend on the machine and are only reported). "save" writes the
+    current numbers as the new baseline instead.
+    `make qualitycheck` runs it against quality_baseline.txt
+*/
+
+#define QUALITY_SEEDS 8
+#define RUNS_PER_PLAN 5
+#define LOOPS_PER_STOP 200
+#define ANYTIME_MS 5
+#define MEMETIC_GENERATIONS 10
+#define MAX_RUNS 256
+#define MAX_QUALITY_METRICS 32
+
+/* one summary number and how much worse it may get before it is a regression */
+struct QualityMetric {
+    char name[64];
+    double value;
+    double tolerance;
+    bool higherIsBetter;
+};
+
+// gaps and times collected for one solver over every run
+struct SolverRuns {
+    double gap[MAX_RUNS];
+    double within1[MAX_RUNS];   // ms to get within 1% of optimal, -1 if never
+    double within5[MAX_RUNS];
+    int length;
+};
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// the value at percentile p of a sorted array
+static double percentileOf(const double *sorted, int length, int p) {
+    if (length == 0) {
+        return 0;
+    }
+    int i = (p * length + 99) / 100 - 1;
+    return sorted[i < 0 ? 0 : i];
+}
+
+// median of the times that reached the target, -1 if none did
+static double medianReached(const double *times, int length) {
+    double reached[MAX_RUNS];
+    int count = 0;
+    for (int i = 0; i < length; i++) {
+        if (times[i] >= 0) {
+            reached[count++] = times[i];
+        }
+    }
+    if (count == 0) {
+        return -1;
+    }
+    qsort(reached, count, sizeof(double), compareDoubles);
+    return percentileOf(reached, count, 50);
+}
+
+// milliseconds until the trace first got within "percent" of optimal, -1 if never
+static double timeWithin(const struct Trace *trace, int optimal, double percent) {
+    for (int i = 0; i < trace->length; i++) {
+        if (trace->cost[i] <= optimal * (1 + percent / 100)) {
+            return trace->seconds[i] * 1000;
+        }
+    }
+    return -1;
+}
+
+// percent the cost is over the optimal day
+static double gapOf(int cost, int optimal) {
+    return 100.0 * (cost - optimal) / optimal;
+}
+
+// no attraction can take a pass, so every solver only picks the visit order
+static void dropPasses(struct Plan *plan) {
+    for (int i = 0; i < plan->length; i++) {
+        plan->passGroup[i] = -1;
+        plan->passFixed[i] = 0;
+    }
+    plan->numGroups = 0;
+    plan->forcePasses = 0;
+}
+
+// solves one plan exactly and with every heuristic, prints one json line
+static void measurePlan(struct Plan *plan, const char *name, unsigned int seed, struct SolverRuns *fastpass, struct SolverRuns *anytime, struct SolverRuns *tabu, struct SolverRuns *vnd, struct SolverRuns *memetic) {
+    int tour[MAX_ROWS];
+    unsigned char usePass[MAX_ROWS] = {0};
+    struct Trace trace;
+    struct TourCache cache;
+    int n = plan->length;
+
+    dropPasses(plan);
+
+    double start = wallClock();
+    int optimal = solveExact(plan, NULL, tour);
+    double exactMs = (wallClock() - start) * 1000;
+
+    double fastpassGap = 0, anytimeGap = 0, tabuGap = 0, vndGap = 0, memeticGap = 0;
+    for (int r = 0; r < RUNS_PER_PLAN && fastpass->length < MAX_RUNS; r++) {
+        srand(seed * RUNS_PER_PLAN + r);
+        memcpy(tour, plan->startTour, n * sizeof(int));
+        int cost = optimizeWithPasses(plan, tour, usePass, LOOPS_PER_STOP * n);
+        fastpass->gap[fastpass->length++] = gapOf(cost, optimal);
+        fastpassGap += gapOf(cost, optimal) / RUNS_PER_PLAN;
+
+        srand(seed * RUNS_PER_PLAN + r);
+        memcpy(tour, plan->startTour, n * sizeof(int));
+        cost = optimizeUntil(plan, tour, usePass, ANYTIME_MS, &trace);
+        anytime->gap[anytime->length] = gapOf(cost, optimal);
+        anytime->within1[anytime->length] = timeWithin(&trace, optimal, 1);
+        anytime->within5[anytime->length] = timeWithin(&trace, optimal, 5);
+        anytime->length++;
+        anytimeGap += gapOf(cost, optimal) / RUNS_PER_PLAN;
+
+        // same number of scored tours as the fastpass budget
+        srand(seed * RUNS_PER_PLAN + r);
+        memcpy(tour, plan->startTour, n * sizeof(int));
+        initTourCache(&cache, plan, 16);
+        cost = optimizeTabu(plan, tour, NULL, LOOPS_PER_STOP * n / 8, &cache);
+        freeTourCache(&cache);
+        tabu->gap[tabu->length++] = gapOf(cost, optimal);
+        tabuGap += gapOf(cost, optimal) / RUNS_PER_PLAN;
+
+        // the descent is deterministic, so each run starts from another order
+        srand(seed * RUNS_PER_PLAN + r);
+        memcpy(tour, plan->startTour, n * sizeof(int));
+        shuffleArray(tour, n);
+        cost = optimizeVnd(plan, tour, NULL);
+        vnd->gap[vnd->length++] = gapOf(cost, optimal);
+        vndGap += gapOf(cost, optimal) / RUNS_PER_PLAN;
+
+        // seeded per run, the same on any number of cores
+        cost = optimizeMemetic(plan, tour, MEMETIC_GENERATIONS, 0, seed * RUNS_PER_PLAN + r);
+        memetic->gap[memetic->length++] = gapOf(cost, optimal);
+        memeticGap += gapOf(cost, optimal) / RUNS_PER_PLAN;
+    }
+
+    printf("{\"plan\":\"%s\",\"stops\":%d,\"optimal\":%d,\"exactMs\":%.3f,\"fastpassGap\":%.3f,\"anytimeGap\":%.3f,\"tabuGap\":%.3f,\"vndGap\":%.3f,\"memeticGap\":%.3f}\n",
+        name, n, optimal, exactMs, fastpassGap, anytimeGap, tabuGap, vndGap, memeticGap);
+    fflush(stdout);
+}
+
+// adds one summary number to the list compared against the baseline
+static void addMetric(struct QualityMetric *metrics, int *count, const char *solver, const char *name, double value, double tolerance, bool higherIsBetter) {
+    struct QualityMetric *m = &metrics[(*count)++];
+    snprintf(m->name, sizeof(m->name), "%s.%s", solver, name);
+    m->value = value;
+    m->tolerance = tolerance;
+    m->higherIsBetter = higherIsBetter;
+}
+
+/* prints the gap distribution of one solver and adds it to the metrics.
+   Gaps after a fixed move budget are deterministic, gaps and times after a
+   deadline depend on the machine, so they get a looser tolerance */
+static void summarize(const char *solver, struct SolverRuns *runs, bool timed, struct QualityMetric *metrics, int *count) {
+    double sorted[MAX_RUNS];
+    double mean = 0;
+    int optimal = 0;
+
+    memcpy(sorted, runs->gap, runs->length * sizeof(double));
+    qsort(sorted, runs->length, sizeof(double), compareDoubles);
+    for (int i = 0; i < runs->length; i++) {
+        mean += sorted[i] / runs->length;
+        if (sorted[i] <= 0) {
+            optimal++;
+        }
+    }
+    double share = runs->length > 0 ? (double)optimal / runs->length : 0;
+    double gapTolerance = timed ? 0.5 : 0.01;
+
+    addMetric(metrics, count, solver, "meanGap", mean, gapTolerance, false);
+    addMetric(metrics, count, solver, "medianGap", percentileOf(sorted, runs->length, 50), gapTolerance, false);
+    addMetric(metrics, count, solver, "p90Gap", percentileOf(sorted, runs->length, 90), gapTolerance, false);
+    addMetric(metrics, count, solver, "maxGap", sorted[runs->length - 1], timed ? 2.0 : 0.01, false);
+    addMetric(metrics, count, solver, "optimalShare", share, timed ? 0.1 : 0.001, true);
+
+    printf("{\"solver\":\"%s\",\"runs\":%d,\"meanGap\":%.3f,\"medianGap\":%.3f,\"p90Gap\":%.3f,\"maxGap\":%.3f,\"optimalShare\":%.3f",
+        solver, runs->length, mean, percentileOf(sorted, runs->length, 50), percentileOf(sorted, runs->length, 90), sorted[runs->length - 1], share);
+
+    if (timed) {
+        double within1 = medianReached(runs->within1, runs->length);
+        double within5 = medianReached(runs->within5, runs->length);
+        printf(",\"within1Ms\":%.3f,\"within5Ms\":%.3f", within1, within5);
+    }
+    printf("}\n");
+}
+
+// writes the summary numbers as the new baseline
+static int saveBaseline(const char *filename, const struct QualityMetric *metrics, int count) {
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL) {
+        printf("Error: Unable to write %s.\n", filename);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%s %.6f\n", metrics[i].name, metrics[i].value);
+    }
+    fclose(fp);
+    printf("Saved baseline to %s\n", filename);
+    return 0;
+}
+
+// compares the summary numbers with the baseline, returns 1 on any regression
+static int checkBaseline(const char *filename, const struct QualityMetric *metrics, int count) {
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        printf("Error: Unable to open %s.\n", filename);
+        return 1;
+    }
+
+    char name[64];
+    double baseline;
+    int regressions = 0;
+    while (fscanf(fp, "%63s %lf", name, &baseline) == 2) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(name, metrics[i].name) != 0) {
+                continue;
+            }
+            double worse = metrics[i].higherIsBetter ? baseline - metrics[i].value : metrics[i].value - baseline;
+            if (worse > metrics[i].tolerance) {
+                printf("Regression: %s is %.3f, baseline %.3f\n", name, metrics[i].value, baseline);
+                regressions++;
+            }
+        }
+    }
+    fclose(fp);
+
+    printf("%d regressions against %s\n", regressions, filename);
+    return regressions > 0;
+}
+
+/* gathers plans from a synthetic park with malformed label lists, which
+   must all be turned away, and with a good one, which must load. Prints one
+   json line and returns whether every list was handled right */
+static bool checkGather() {
+    struct Plan plan, gathered;
+    struct Park park;
+    generatePark(&plan, 12, 1);
+    int e = plan.key[0], a = plan.key[1], b = plan.key[2], c = plan.key[3];
+    int good[] = {e, a, b, c, e};
+    int bad[][5] = {
+        {a, b, c, e, e},    // doesn't start at the entrance
+        {e, a, b, c, a},    // doesn't end there
+        {e, a, a, a, e},    // repeats an attraction
+        {e, a, e, b, e},    // passes the entrance
+    };
+    int numBad = sizeof(bad) / sizeof(bad[0]);
+    int rejected = 0;
+    bool loaded;
+
+    // the park borrows the plan's matrices, only its index is its own
+    memset(&park, 0, sizeof(struct Park));
+    park.plan = plan;
+    indexPark(&park);
+
+    for (int i = 0; i < numBad; i++) {
+        if (gatherPlan(&park, bad[i], 5, plan.startTime, plan.stopTime, &gathered) != 0) {
+            rejected++;
+        } else {
+            freePlan(&gathered);
+        }
+    }
+    loaded = gatherPlan(&park, good, 5, plan.startTime, plan.stopTime, &gathered) == 0;
+    if (loaded) {
+        freePlan(&gathered);
+    }
+
+    free(park.rowOfLabel);
+    freePlan(&plan);
+    printf("{\"check\":\"gatherLabels\",\"rejected\":%d,\"malformed\":%d,\"loaded\":%s}\n", rejected, numBad, loaded ? "true" : "false");
+    return rejected == numBad && loaded;
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = {8, 10, 12};
+    int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    struct SolverRuns fastpass = {0}, anytime = {0}, tabu = {0}, vnd = {0}, memetic = {0};
+    struct QualityMetric metrics[MAX_QUALITY_METRICS];
+    int count = 0;
+    char name[64];
+
+    for (int i = 0; i < numSizes; i++) {
+        for (unsigned int seed = 1; seed <= QUALITY_SEEDS; seed++) {
+            struct Plan plan;
+            generatePark(&plan, sizes[i], seed);
+            snprintf(name, sizeof(name), "synthetic-%d-%u", sizes[i], seed);
+            measurePlan(&plan, name, seed, &fastpass, &anytime, &tabu, &vnd, &memetic);
+            freePlan(&plan);
+        }
+    }
+
+    // the real plan, if it is next to the binary
+    FILE *fp = fopen("useCase.json", "r");
+    if (fp != NULL) {
+        fclose(fp);
+        cJSON *json = readPlanFile("useCase.json");
+        struct Plan plan;
+        if (json != NULL && loadPlan(json, &plan) == 0) {
+            measurePlan(&plan, "useCase.json", 0, &fastpass, &anytime, &tabu, &vnd, &memetic);
+            freePlan(&plan);
+        }
+        cJSON_Delete(json);
+    }
+
+    if (!checkGather()) {
+        printf("gathered plans accept malformed label lists\n");
+        return 1;
+    }
+
+    summarize("fastpass", &fastpass, false, metrics, &count);
+    summarize("anytime", &anytime, true, metrics, &count);
+    summarize("tabu", &tabu, false, metrics, &count);
+    summarize("vnd", &vnd, false, metrics, &count);
+    summarize("memetic", &memetic, false, metrics, &count);
+
+    if (argc > 2 && strcmp(argv[2], "save") == 0) {
+        return saveBaseline(argv[1], metrics, count);
+    }
+    if (argc > 1) {
+        return checkBaseline(argv[1], metrics, count);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// replan.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/*............................................................................*/
+
+/* Replan Functions:
+	1. updateWaits -> swaps new standby waits into a loaded plan without
+	   going back to the json
+	2. replanTour -> re-optimizes the rest of the day from where the guest is
+	   now, warm started from their previous tour
+
+   A replanned tour keeps the full plan length so every scoring function
+   works on it unchanged: the entrance and the stops already visited come
+   first, then the guest's current location, then the stops still to do,
+   then the exit. A guest still at the entrance hasn't visited anything, so
+   their current location is the entrance itself at position 0. The timeline is pinned to the current time at the current
+   location, and moves only touch the positions after it. A Replan tour can
+   be passed back in as the previous tour for the next replan. */
+
+
+/* swaps new standby waits (a length x numSlices WaitMatrix) into a loaded
+   plan. Scenario lane 0 follows WaitMatrix, so it is refreshed too, and so
+   is the return table of a plan without pass groups, which loadFastPass()
+   made a copy of the standby table. flatWaits is worked out again, since
+   the solvers take shortcuts when the waits never change */
+void updateWaits(struct Plan *plan, const int *waitMatrix) {
+	int cells = plan->length * plan->numSlices;
+
+	buildWaitTable(waitMatrix, plan->length, plan->numSlices, plan->waitTable);
+	for (int c = 0; c < cells; c++) {
+		plan->scenarioTable[c * SCENARIO_LANES] = plan->waitTable[c];
+	}
+	if (plan->numGroups == 0) {
+		memcpy(plan->returnTable, plan->waitTable, cells * sizeof(int));
+	}
+	detectSymmetry(plan);
+}
+
+/* re-optimizes the rest of the day. The guest is at currentRow (0 for the
+   entrance, before any stop) at currentTime, visited[row] is 1 for every
+   stop they are done with, and previousTour is the tour they were
+   following. The remaining stops keep their previous order as the starting
+   point, then first improvement segment reversals run over the remaining
+   positions only until none helps or maxMoves candidates were scored.
+   Returns the time the guest gets back to the entrance, or RESULT_ERROR
+   for a guest at the exit row or at the entrance with stops visited */
+int replanTour(const struct Plan *plan, const int *previousTour, const unsigned char *visited, int currentRow, int currentTime, const unsigned char *usePass, int maxMoves, struct Replan *result) {
+	int n = plan->length;
+	int *tour = result->tour;
+	int *offTimes = result->offTimes;
+	int trialTimes[MAX_ROWS];
+	int count = 0;
+
+	if (currentRow <= 0 || currentRow >= n - 1) {
+		bool started = false;
+		for (int row = 1; row < n - 1; row++) {
+			started |= visited[row] != 0;
+		}
+		if (currentRow != 0 || started) {
+			printf("Error: a replan starts at an attraction, or at the entrance before any stop.\n");
+			return RESULT_ERROR;
+		}
+	}
+
+	// the day always starts at the entrance
+	tour[count++] = 0;
+
+	// stops already done, in the order they were done
+	for (int i = 0; i < n; i++) {
+		int row = previousTour[i];
+		if (row != 0 && row != n - 1 && visited[row] && row != currentRow) {
+			tour[count++] = row;
+		}
+	}
+
+	if (currentRow != 0) {
+		tour[count++] = currentRow;
+	}
+	result->current = count - 1;
+
+	// the rest, warm started from the previous order
+	for (int i = 0; i < n; i++) {
+		int row = previousTour[i];
+		if (row != 0 && row != n - 1 && !visited[row] && row != currentRow) {
+			tour[count++] = row;
+		}
+	}
+
+	tour[n - 1] = n - 1;
+
+	int current = result->current;
+	for (int i = 0; i <= current; i++) {
+		offTimes[i] = currentTime;
+	}
+	int cost = rescheduleFrom(plan, tour, usePass, offTimes, current + 1);
+
+	bool improved = true;
+	while (improved && maxMoves > 0) {
+		improved = false;
+
+		for (int lo = current + 1; lo < n - 2 && maxMoves > 0; lo++) {
+			for (int hi = lo + 1; hi < n - 1 && maxMoves > 0; hi++) {
+				maxMoves--;
+
+				for (int a = lo, b = hi; a < b; a++, b--) {
+					swap(&tour[a], &tour[b]);
+				}
+				int new_cost = evaluateSuffix(plan, tour, usePass, offTimes, trialTimes, lo, hi + 1);
+
+				if (new_cost < cost) {
+					cost = new_cost;
+					planMetrics.movesAccepted++;
+					noteImprovement();
+					rescheduleFrom(plan, tour, usePass, offTimes, lo);
+					improved = true;
+				} else {
+					for (int a = lo, b = hi; a < b; a++, b--) {
+						swap(&tour[a], &tour[b]);
+					}
+				}
+			}
+		}
+	}
+
+	result->finishTime = offTimes[n - 1];
+	return result->finishTime;
+}
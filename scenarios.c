@@ -0,0 +1,263 @@
+// scenarios.c
+
+#include <stdio.h>
+#include <cjson/cJSON.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+#define RESULT_ERROR (-1)
+
+/* times are clamped to two days past the wait matrix start, which keeps the
+   unsigned reciprocal slice division below exact for any segment up to 398
+   minutes */
+#define MAX_OFFSET 2880
+
+/*............................................................................*/
+
+/* Scenario Functions:
+	1. setScenario -> copies one averaged wait table into its scenario lane
+	2. loadScenarios -> loads WaitMatrix and every other Wait...Matrix
+	   (WaitXXXMatrix) into one table with the scenarios side by side
+	3. scheduleScenarios -> computes a tour's timeline in every scenario at
+	   once, one scenario per lane
+	4. scenarioScore -> folds the scenario totals into the expected, worst
+	   case or percentile time
+	5. evaluateScenarios -> scores a whole tour against all scenarios
+	6. optimizeRobust -> random segment reversals scored on the robust
+	   objective, rescheduling only from the first changed stop
+
+   The scenario table is laid out [row][slice][lane], so the waits of all
+   scenarios for one row and slice are next to each other and a stop updates
+   SCENARIO_LANES timelines in one straight loop the compiler can vectorize.
+   Unused lanes repeat scenario 0 and are ignored by the objective. */
+
+
+// true for keys like WaitXXXMatrix, but not WaitMatrix itself
+static bool isScenarioKey(const char *name) {
+	size_t length = strlen(name);
+	return length > strlen("WaitMatrix") && strncmp(name, "Wait", 4) == 0
+		&& strcmp(name + length - 6, "Matrix") == 0;
+}
+
+// copies one averaged wait table into its lane of the scenario table
+void setScenario(struct Plan *plan, const int *table, int lane) {
+	int cells = plan->length * plan->numSlices;
+	for (int c = 0; c < cells; c++) {
+		plan->scenarioTable[c * SCENARIO_LANES + lane] = table[c];
+	}
+}
+
+/* loads WaitMatrix and every other Wait...Matrix into the scenario table.
+   ScenarioWeights gives the probability of each scenario in load order,
+   otherwise they are equally likely */
+int loadScenarios(const cJSON *json, struct Plan *plan) {
+	int n = plan->length;
+	int slices = plan->numSlices;
+
+	for (int lane = 0; lane < SCENARIO_LANES; lane++) {
+		setScenario(plan, plan->waitTable, lane);
+	}
+	plan->numScenarios = 1;
+
+	// read and averaged in the plan's scratch table, so loading allocates nothing
+	int *matrix = plan->scratchTable;
+	int *table = plan->scratchTable + n * slices;
+
+	cJSON *item;
+	cJSON_ArrayForEach(item, json) {
+		if (item->string == NULL || !isScenarioKey(item->string)) {
+			continue;
+		}
+		if (plan->numScenarios == SCENARIO_LANES) {
+			printf("Only the first %d wait scenarios are used.\n", SCENARIO_LANES);
+			break;
+		}
+		if (readMatrix(item, n, slices, matrix, item->string) != 0) {
+			return RESULT_ERROR;
+		}
+		buildWaitTable(matrix, n, slices, table);
+		setScenario(plan, table, plan->numScenarios);
+		plan->numScenarios++;
+	}
+
+	cJSON *weights = cJSON_GetObjectItemCaseSensitive(json, "ScenarioWeights");
+	double total = 0;
+	for (int k = 0; k < plan->numScenarios; k++) {
+		cJSON *weight = cJSON_GetArrayItem(weights, k);
+		plan->scenarioWeight[k] = cJSON_IsNumber(weight) ? weight->valuedouble : 1.0;
+		total += plan->scenarioWeight[k];
+	}
+	for (int k = 0; k < plan->numScenarios; k++) {
+		plan->scenarioWeight[k] = total > 0 ? plan->scenarioWeight[k] / total : 1.0 / plan->numScenarios;
+	}
+	return 0;
+}
+
+/* computes a tour's timeline in every scenario at once, from position "from"
+   on. offLanes[i][k] is when the guest gets off stop i in scenario k. The
+   slice lookup divides by a reciprocal multiply so the lane loop has no
+   integer division in it */
+void scheduleScenarios(const struct Plan *plan, const int *tour, const unsigned char *usePass, int offLanes[][SCENARIO_LANES], int from) {
+	int n = plan->length;
+	int slices = plan->numSlices;
+	int lastSlice = slices - 1;
+	int matrixStart = plan->matrixStart;
+	unsigned int reciprocal = (1u << 20) / plan->segment + 1;
+
+	if (from == 1) {
+		for (int k = 0; k < SCENARIO_LANES; k++) {
+			offLanes[0][k] = plan->startTime;
+		}
+	}
+
+	int off[SCENARIO_LANES];
+	memcpy(off, offLanes[from - 1], sizeof(off));
+
+	for (int i = from; i < n - 1; i++) {
+		int row = tour[i];
+		int walk = plan->walk[tour[i - 1] * n + row];
+		int ride = plan->rideTime[row];
+
+		if (usePass != NULL && usePass[row]) {
+			// a pass has one return-window table shared by every scenario
+			for (int k = 0; k < SCENARIO_LANES; k++) {
+				int arrival = off[k] + walk;
+				off[k] = arrival + tableAt(plan, plan->returnTable, row, arrival) + ride;
+			}
+		} else {
+			const int *waits = plan->scenarioTable + row * slices * SCENARIO_LANES;
+			for (int k = 0; k < SCENARIO_LANES; k++) {
+				int arrival = off[k] + walk;
+				int offset = arrival - matrixStart;
+				offset = offset < 0 ? 0 : offset;
+				offset = offset > MAX_OFFSET ? MAX_OFFSET : offset;
+				int s = ((unsigned int)offset * reciprocal) >> 20;
+				s = s > lastSlice ? lastSlice : s;
+				off[k] = arrival + waits[s * SCENARIO_LANES + k] + ride;
+			}
+		}
+		memcpy(offLanes[i], off, sizeof(off));
+	}
+
+	int walk = plan->walk[tour[n - 2] * n + tour[n - 1]];
+	for (int k = 0; k < SCENARIO_LANES; k++) {
+		offLanes[n - 1][k] = off[k] + walk;
+	}
+}
+
+/* folds the scenario totals into one score: the probability weighted mean,
+   the worst scenario, or the smallest total that at least "percentile" % of
+   the probability is at or under */
+double scenarioScore(const struct Plan *plan, const int *totals, int objective, int percentile) {
+	int k_max = plan->numScenarios;
+
+	if (objective == OBJECTIVE_WORST) {
+		return getMax((int*)totals, k_max);
+	}
+
+	if (objective == OBJECTIVE_PERCENTILE) {
+		// insertion sort of at most SCENARIO_LANES (total, scenario) pairs
+		int order[SCENARIO_LANES];
+		for (int k = 0; k < k_max; k++) {
+			int j = k;
+			while (j > 0 && totals[order[j - 1]] > totals[k]) {
+				order[j] = order[j - 1];
+				j--;
+			}
+			order[j] = k;
+		}
+
+		double covered = 0;
+		for (int k = 0; k < k_max; k++) {
+			covered += plan->scenarioWeight[order[k]];
+			if (covered * 100 >= percentile - 1e-9) {
+				return totals[order[k]];
+			}
+		}
+		return totals[order[k_max - 1]];
+	}
+
+	double expected = 0;
+	for (int k = 0; k < k_max; k++) {
+		expected += plan->scenarioWeight[k] * totals[k];
+	}
+	return expected;
+}
+
+/* scores a whole tour against all scenarios. totals (optional) gets the
+   total time of each scenario */
+double evaluateScenarios(const struct Plan *plan, const int *tour, const unsigned char *usePass, int objective, int percentile, int *totals) {
+	int offLanes[MAX_ROWS][SCENARIO_LANES];
+	int scratch[SCENARIO_LANES];
+	if (totals == NULL) {
+		totals = scratch;
+	}
+
+	scheduleScenarios(plan, tour, usePass, offLanes, 1);
+	for (int k = 0; k < SCENARIO_LANES; k++) {
+		totals[k] = offLanes[plan->length - 1][k] - plan->startTime;
+	}
+	return scenarioScore(plan, totals, objective, percentile);
+}
+
+/* random segment reversals like the walking search in findDistance.c, but
+   each candidate is scored on the robust objective across every scenario.
+   Only the stops from the start of the reversed segment on are rescheduled.
+   tour is updated in place, returns the best score */
+double optimizeRobust(const struct Plan *plan, int *tour, const unsigned char *usePass, int objective, int percentile, int maxLoops) {
+	int n = plan->length;
+	int offLanes[MAX_ROWS][SCENARIO_LANES];
+	int totals[SCENARIO_LANES];
+
+	if (n < 4) {
+		return evaluateScenarios(plan, tour, usePass, objective, percentile, NULL);
+	}
+
+	scheduleScenarios(plan, tour, usePass, offLanes, 1);
+	for (int k = 0; k < SCENARIO_LANES; k++) {
+		totals[k] = offLanes[n - 1][k] - plan->startTime;
+	}
+	double best = scenarioScore(plan, totals, objective, percentile);
+
+	int saved[MAX_ROWS][SCENARIO_LANES];
+
+	while (maxLoops-- > 0) {
+		int p1 = (rand() % (n - 2)) + 1;
+		int p2 = p1;
+		while (p2 == p1) {
+			p2 = (rand() % (n - 2)) + 1;
+		}
+		int lo = p1 < p2 ? p1 : p2;
+		int hi = p1 < p2 ? p2 : p1;
+
+		for (int a = lo, b = hi; a < b; a++, b--) {
+			swap(&tour[a], &tour[b]);
+		}
+
+		// keep the old suffix so a rejected move costs no second reschedule
+		memcpy(saved[lo], offLanes[lo], (n - lo) * sizeof(offLanes[0]));
+		scheduleScenarios(plan, tour, usePass, offLanes, lo);
+		for (int k = 0; k < SCENARIO_LANES; k++) {
+			totals[k] = offLanes[n - 1][k] - plan->startTime;
+		}
+		double score = scenarioScore(plan, totals, objective, percentile);
+		planMetrics.movesEvaluated++;
+
+		if (score < best) {
+			best = score;
+			planMetrics.movesAccepted++;
+			noteImprovement();
+		} else {
+			for (int a = lo, b = hi; a < b; a++, b--) {
+				swap(&tour[a], &tour[b]);
+			}
+			memcpy(offLanes[lo], saved[lo], (n - lo) * sizeof(offLanes[0]));
+		}
+	}
+
+	return best;
+}
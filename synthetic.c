@@ -0,0 +1,137 @@
+// synthetic.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* park layout used by the generator */
+#define WALK_METERS_PER_MINUTE 70.0
+#define LAND_RADIUS 500.0
+#define LAND_SPREAD 120.0
+#define ENTRANCE_DISTANCE 700.0
+
+/* same day shape as useCase.json: 8 AM to 10 PM in 15 minute slices */
+#define SYNTHETIC_SLICES 57
+#define SYNTHETIC_SEGMENT 15
+#define SYNTHETIC_START 480
+#define SYNTHETIC_STOP 1320
+
+/*............................................................................*/
+
+/* Synthetic Park Functions:
+	1. nextRandom -> small deterministic generator so a seed always gives
+	   the same park, independent of rand()
+	2. generatePark -> builds a plan with n stops (entrance at both ends)
+	   straight into the solver tables, no json involved
+
+   Attractions are grouped into lands around a central hub with the entrance
+   to the south. Walking minutes are straight-line distances at walking
+   speed, so the matrix is metric apart from rounding, with 1 on the
+   diagonal like DistanceMatrix. Standby waits ramp up through the morning,
+   peak mid-day and fall off in the evening, scaled by how popular the ride
+   is. A second, busier wait scenario is added, and the most popular quarter
+   of the park forms one pass group with a limit of 3. */
+
+
+// small deterministic generator (xorshift) returning a value in [0, 1)
+static double nextRandom(unsigned long long *state) {
+	return (double)(xorshift64(state) >> 11) / 9007199254740992.0;
+}
+
+/* builds a plan with n stops (entrance at both ends, n - 2 attractions)
+   straight into the solver tables. The same seed always gives the same
+   park. Free it with freePlan */
+void generatePark(struct Plan *plan, int n, unsigned int seed) {
+	unsigned long long state = GOLDEN_GAMMA ^ ((unsigned long long)seed << 1 | 1);
+	double x[MAX_ROWS], y[MAX_ROWS], popularity[MAX_ROWS];
+	int waits[SYNTHETIC_SLICES], busy[SYNTHETIC_SLICES * MAX_ROWS];
+
+	memset(plan, 0, sizeof(struct Plan));
+	allocPlan(plan, n, SYNTHETIC_SLICES);
+	plan->segment = SYNTHETIC_SEGMENT;
+	plan->startTime = SYNTHETIC_START;
+	plan->stopTime = SYNTHETIC_STOP;
+	plan->matrixStart = SYNTHETIC_START;
+	plan->walkingWeight = 1;
+	plan->waitingWeight = 1;
+
+	int lands = 2 + n / 15;
+
+	// the entrance is row 0 and row n - 1, at the same spot
+	x[0] = x[n - 1] = 0;
+	y[0] = y[n - 1] = -ENTRANCE_DISTANCE;
+	popularity[0] = popularity[n - 1] = 0;
+
+	for (int i = 1; i < n - 1; i++) {
+		double angle = 2 * 3.14159265358979 * (i % lands) / lands;
+		x[i] = LAND_RADIUS * cos(angle) + LAND_SPREAD * (2 * nextRandom(&state) - 1);
+		y[i] = LAND_RADIUS * sin(angle) + LAND_SPREAD * (2 * nextRandom(&state) - 1);
+		popularity[i] = 0.1 + 0.9 * nextRandom(&state);
+	}
+
+	for (int i = 0; i < n; i++) {
+		plan->key[i] = (i == 0 || i == n - 1) ? 0 : i;
+		plan->startTour[i] = i;
+
+		for (int j = 0; j < n; j++) {
+			double dist = sqrt((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]));
+			plan->walk[i * n + j] = 1 + (int)(dist / WALK_METERS_PER_MINUTE + 0.5);
+		}
+	}
+
+	for (int i = 1; i < n - 1; i++) {
+		double peak = 5 + 100 * popularity[i] * popularity[i];
+
+		plan->rideTime[i] = 2 + (int)(14 * nextRandom(&state));
+		plan->priority[i] = 1 + (int)(4 * popularity[i]);
+
+		// slice 0 is empty like the real matrices, then the daily curve
+		waits[0] = 0;
+		for (int s = 1; s < SYNTHETIC_SLICES; s++) {
+			double morning = s < 8 ? s / 8.0 : 1.0;
+			double evening = s > 36 ? 1.0 - 0.5 * (s - 36) / (SYNTHETIC_SLICES - 36.0) : 1.0;
+			double noise = 0.9 + 0.2 * nextRandom(&state);
+			waits[s] = (int)(peak * morning * evening * noise);
+		}
+		for (int s = 0; s < SYNTHETIC_SLICES; s++) {
+			busy[i * SYNTHETIC_SLICES + s] = waits[s] == 0 ? 0 : (int)(waits[s] * 1.35) + 5;
+			plan->returnTable[i * SYNTHETIC_SLICES + s] = 5 + (int)(10 * popularity[i]);
+		}
+		buildWaitTable(waits, 1, SYNTHETIC_SLICES, plan->waitTable + i * SYNTHETIC_SLICES);
+	}
+
+	// standby waits in every lane, then the busy day in lane 1
+	int *table = (int*)malloc(n * SYNTHETIC_SLICES * sizeof(int));
+	memset(busy, 0, SYNTHETIC_SLICES * sizeof(int));
+	memset(busy + (n - 1) * SYNTHETIC_SLICES, 0, SYNTHETIC_SLICES * sizeof(int));
+	buildWaitTable(busy, n, SYNTHETIC_SLICES, table);
+	for (int lane = 0; lane < SCENARIO_LANES; lane++) {
+		setScenario(plan, lane == 1 ? table : plan->waitTable, lane);
+	}
+	free(table);
+	plan->numScenarios = 2;
+	plan->scenarioWeight[0] = 0.7;
+	plan->scenarioWeight[1] = 0.3;
+
+	// the most popular quarter of the park shares one pass group
+	plan->numGroups = 1;
+	plan->groupLimit[0] = 3;
+	for (int i = 1; i < n - 1; i++) {
+		int more_popular = 0;
+		for (int j = 1; j < n - 1; j++) {
+			if (popularity[j] > popularity[i]) {
+				more_popular++;
+			}
+		}
+		if (more_popular < (n - 2 + 3) / 4) {
+			plan->passGroup[i] = 0;
+		}
+	}
+
+	closePlanWalks(plan);
+	detectSymmetry(plan);
+}
@@ -0,0 +1,213 @@
+// tabu.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* slots tried after a tour's home slot before the home slot is overwritten */
+#define CACHE_PROBES 4
+
+/* reversals sampled per tabu step, and how many steps a left tour stays tabu */
+#define TABU_SAMPLES 8
+#define TABU_TENURE 50
+
+/*............................................................................*/
+
+/* Tabu Functions:
+	1. initTourCache -> allocates the cache table and the zobrist keys for a
+	   plan's length
+	2. freeTourCache -> frees what initTourCache allocated
+	3. hashTour -> zobrist hash of a whole tour
+	4. hashReversal -> hash of the tour with one segment reversed, without
+	   building that tour
+	5. findTour -> the cache entry of a tour hash, NULL if it isn't cached
+	6. storeTour -> caches the cost of a tour hash
+	7. optimizeTabu -> random-sampled reversal search that always moves to
+	   the best sampled tour that isn't tabu, so it can climb out of the
+	   local optima the hill climbers stop in
+
+   The cache is a fixed-size, open-addressed and lossy table of tour costs:
+   a tour is looked up in its home slot and the next CACHE_PROBES - 1, and
+   when they are all taken the home slot is overwritten. A tour's hash is
+   the xor of one random key per (position, row), so a reversal changes the
+   hash by the keys of the positions it moves and a neighbour can be looked
+   up without building it. Each entry also records until which step the
+   tour is tabu, so the tabu list costs nothing extra and forgets tours
+   only when the cache does. Two tours share a hash with probability about
+   2^-64 per pair, which is far below anything the search would notice. */
+
+
+/* allocates a cache of 2^bits entries and the zobrist keys for tours of the
+   plan's length. Free it with freeTourCache */
+void initTourCache(struct TourCache *cache, const struct Plan *plan, int bits) {
+	int n = plan->length;
+	unsigned long long state = GOLDEN_GAMMA;
+
+	cache->length = n;
+	cache->mask = (1u << bits) - 1;
+	cache->entries = (struct CacheEntry*)calloc(cache->mask + 1, sizeof(struct CacheEntry));
+	cache->keys = (unsigned long long*)malloc(n * n * sizeof(unsigned long long));
+	for (int k = 0; k < n * n; k++) {
+		cache->keys[k] = xorshift64(&state);
+	}
+}
+
+// frees what initTourCache allocated
+void freeTourCache(struct TourCache *cache) {
+	free(cache->entries);
+	free(cache->keys);
+	memset(cache, 0, sizeof(struct TourCache));
+}
+
+// zobrist hash of a whole tour
+unsigned long long hashTour(const struct TourCache *cache, const int *tour) {
+	int n = cache->length;
+	unsigned long long hash = 0;
+	for (int i = 0; i < n; i++) {
+		hash ^= cache->keys[i * n + tour[i]];
+	}
+	return hash;
+}
+
+/* hash of the tour with tour[lo..hi] reversed, from the hash of the tour.
+   Costs hi - lo key lookups and never builds the reversed tour */
+unsigned long long hashReversal(const struct TourCache *cache, const int *tour, unsigned long long hash, int lo, int hi) {
+	int n = cache->length;
+	for (int i = lo; i <= hi; i++) {
+		hash ^= cache->keys[i * n + tour[i]] ^ cache->keys[i * n + tour[lo + hi - i]];
+	}
+	return hash;
+}
+
+// the cache entry of a tour hash, NULL if it isn't cached
+struct CacheEntry* findTour(struct TourCache *cache, unsigned long long hash) {
+	for (unsigned int p = 0; p < CACHE_PROBES; p++) {
+		struct CacheEntry *entry = &cache->entries[(hash + p) & cache->mask];
+		if (entry->hash == hash) {
+			return entry;
+		}
+		if (entry->hash == 0) {
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+/* caches the cost of a tour hash in the first free probe slot, or over the
+   home slot when they are all taken. Returns the entry, which is not tabu */
+struct CacheEntry* storeTour(struct TourCache *cache, unsigned long long hash, int cost) {
+	struct CacheEntry *entry = &cache->entries[hash & cache->mask];
+	for (unsigned int p = 0; p < CACHE_PROBES; p++) {
+		struct CacheEntry *slot = &cache->entries[(hash + p) & cache->mask];
+		if (slot->hash == 0 || slot->hash == hash) {
+			entry = slot;
+			break;
+		}
+	}
+
+	entry->hash = hash;
+	entry->cost = cost;
+	entry->tabuUntil = 0;
+	return entry;
+}
+
+/* tabu search over segment reversals. Each step samples TABU_SAMPLES random
+   reversals of the current tour, looks their cost up in the cache (or
+   schedules and caches them) and moves to the cheapest one that isn't tabu,
+   even when it is worse. The tour being left stays tabu for TABU_TENURE
+   steps so the search can't fall straight back into it. The cache must only
+   hold tours of this plan scored with the same passes. Every tour it
+   schedules is offered to plan->alternatives when that is set. tour gets
+   the best tour seen in maxSteps steps, or the first within
+   plan->stopCost, returns its total time */
+int optimizeTabu(const struct Plan *plan, int *tour, const unsigned char *usePass, int maxSteps, struct TourCache *cache) {
+	int n = plan->length;
+	int current[MAX_ROWS], trial[MAX_ROWS];
+
+	if (n < 4) {
+		return scheduleTour(plan, tour, usePass, NULL);
+	}
+
+	memcpy(current, tour, n * sizeof(int));
+	unsigned long long hash = hashTour(cache, current);
+	int cost = scheduleTour(plan, current, usePass, NULL);
+	int best = cost;
+	if (plan->alternatives != NULL) {
+		offerBestTour(plan->alternatives, current, n, cost);
+	}
+
+	for (int step = 1; step <= maxSteps && keepSearching(plan, best); step++) {
+		int move_lo = 0, move_hi = 0, move_cost = 0;
+		unsigned long long move_hash = 0;
+		bool found = false;
+
+		for (int k = 0; k < TABU_SAMPLES; k++) {
+			int p1 = (rand() % (n - 2)) + 1;
+			int p2 = p1;
+			while (p2 == p1) {
+				p2 = (rand() % (n - 2)) + 1;
+			}
+			int lo = p1 < p2 ? p1 : p2;
+			int hi = p1 < p2 ? p2 : p1;
+
+			unsigned long long trial_hash = hashReversal(cache, current, hash, lo, hi);
+			struct CacheEntry *entry = findTour(cache, trial_hash);
+			if (entry != NULL && entry->tabuUntil >= step) {
+				continue;
+			}
+
+			int trial_cost;
+			if (entry != NULL) {
+				trial_cost = entry->cost;
+				planMetrics.cacheHits++;
+			} else {
+				flipTour(plan, current, trial, lo, hi);
+				trial_cost = scheduleTour(plan, trial, usePass, NULL);
+				storeTour(cache, trial_hash, trial_cost);
+				planMetrics.movesEvaluated++;
+				if (plan->alternatives != NULL) {
+					offerBestTour(plan->alternatives, trial, n, trial_cost);
+				}
+			}
+
+			if (!found || trial_cost < move_cost) {
+				found = true;
+				move_lo = lo;
+				move_hi = hi;
+				move_cost = trial_cost;
+				move_hash = trial_hash;
+			}
+		}
+
+		// every sample was tabu
+		if (!found) {
+			continue;
+		}
+
+		// the tour being left can't come back for a while
+		struct CacheEntry *left = findTour(cache, hash);
+		if (left == NULL) {
+			left = storeTour(cache, hash, cost);
+		}
+		left->tabuUntil = step + TABU_TENURE;
+
+		for (int a = move_lo, b = move_hi; a < b; a++, b--) {
+			swap(&current[a], &current[b]);
+		}
+		hash = move_hash;
+		cost = move_cost;
+		planMetrics.movesAccepted++;
+
+		if (cost < best) {
+			best = cost;
+			memcpy(tour, current, n * sizeof(int));
+			noteImprovement();
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,242 @@
+// vnd.c
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "functions.h"
+
+/*............................................................................*/
+
+/* the neighbourhoods in the order the descent tries them, cheapest first */
+#define MOVE_RELOCATE 0
+#define MOVE_SWAP 1
+#define MOVE_OR_OPT 2
+#define MOVE_TWO_OPT 3
+#define NUM_MOVES 4
+
+/* longest run of stops an or-opt move carries */
+#define OR_OPT_LONGEST 3
+
+/*............................................................................*/
+
+/* VND Functions:
+	1. relocateDelta -> walking change of moving a run of stops elsewhere,
+	   kept in order or reversed (relocate and or-opt)
+	2. swapDelta -> walking change of exchanging two stops
+	3. twoOptDelta -> walking change of reversing a segment
+	4. optimizeVnd -> variable neighbourhood descent over the four moves
+
+   Every move rearranges one window tour[lo..hi] and leaves the rest of the
+   tour alone. Each move type has a delta evaluator that gives the change in
+   walking from the few walks at the window's edges in constant time; the
+   walks inside a reversed run come from prefix sums of the tour's walking
+   in both directions, which is what makes reversals O(1) on an asymmetric
+   matrix. When the day is only walking plus fixed waits (flatWaits, no
+   passes) that delta is the change of the day and no move is scheduled at
+   all. Otherwise the window is written into a copy of the tour and scored
+   with evaluateSuffix() from lo on, which stops as soon as the new
+   timeline meets the old one.
+
+   The descent tries relocate (one stop), swap, or-opt (runs of 2 to
+   OR_OPT_LONGEST stops, either way round) and 2-opt in that order. The
+   first improving move found is made and the descent starts over at
+   relocate, and it stops when no neighbourhood has an improving move. */
+
+
+// the walking arrays of a tour, fwd[i] and bwd[i] walk positions 0..i each way
+struct Walks {
+	int fwd[MAX_ROWS];
+	int bwd[MAX_ROWS];
+};
+
+// walk from row a to row b
+static int walkOf(const struct Plan *plan, int a, int b) {
+	return plan->walk[a * plan->length + b];
+}
+
+// prefix sums of the tour's walking forward and against the tour's direction
+static void sumWalks(const struct Plan *plan, const int *tour, struct Walks *walks) {
+	walks->fwd[0] = 0;
+	walks->bwd[0] = 0;
+	for (int i = 1; i < plan->length; i++) {
+		walks->fwd[i] = walks->fwd[i - 1] + walkOf(plan, tour[i - 1], tour[i]);
+		walks->bwd[i] = walks->bwd[i - 1] + walkOf(plan, tour[i], tour[i - 1]);
+	}
+}
+
+/* walking change of moving the run tour[a..b] to between positions c and
+   c + 1 (c outside a - 1..b), reversed when "reversed" is set */
+static int relocateDelta(const struct Plan *plan, const int *tour, const struct Walks *walks, int a, int b, int c, bool reversed) {
+	int p = tour[a - 1], s = tour[a], e = tour[b], q = tour[b + 1];
+	int x = tour[c], y = tour[c + 1];
+
+	int delta = walkOf(plan, p, q) - walkOf(plan, p, s) - walkOf(plan, e, q) - walkOf(plan, x, y);
+	if (reversed) {
+		delta += walkOf(plan, x, e) + walkOf(plan, s, y)
+			+ (walks->bwd[b] - walks->bwd[a]) - (walks->fwd[b] - walks->fwd[a]);
+	} else {
+		delta += walkOf(plan, x, s) + walkOf(plan, e, y);
+	}
+	return delta;
+}
+
+// walking change of exchanging the stops at positions i < j
+static int swapDelta(const struct Plan *plan, const int *tour, int i, int j) {
+	int p = tour[i - 1], a = tour[i], b = tour[j], q = tour[j + 1];
+
+	if (j == i + 1) {
+		return walkOf(plan, p, b) + walkOf(plan, b, a) + walkOf(plan, a, q)
+			- walkOf(plan, p, a) - walkOf(plan, a, b) - walkOf(plan, b, q);
+	}
+	int an = tour[i + 1], bp = tour[j - 1];
+	return walkOf(plan, p, b) + walkOf(plan, b, an) + walkOf(plan, bp, a) + walkOf(plan, a, q)
+		- walkOf(plan, p, a) - walkOf(plan, a, an) - walkOf(plan, bp, b) - walkOf(plan, b, q);
+}
+
+// walking change of reversing tour[i..j], i < j
+static int twoOptDelta(const struct Plan *plan, const int *tour, const struct Walks *walks, int i, int j) {
+	int p = tour[i - 1], q = tour[j + 1];
+	return walkOf(plan, p, tour[j]) + (walks->bwd[j] - walks->bwd[i]) + walkOf(plan, tour[i], q)
+		- walkOf(plan, p, tour[i]) - (walks->fwd[j] - walks->fwd[i]) - walkOf(plan, tour[j], q);
+}
+
+/* writes the tour with the run tour[a..b] moved to between c and c + 1 into
+   trial, returns the first position that changed (the last is *hi) */
+static int applyRelocate(const int *tour, int *trial, int n, int a, int b, int c, bool reversed, int *hi) {
+	int len = b - a + 1;
+	int at, lo;
+
+	memcpy(trial, tour, n * sizeof(int));
+	if (c < a) {
+		// the stops between c and a slide right behind the run
+		memcpy(trial + c + 1 + len, tour + c + 1, (a - c - 1) * sizeof(int));
+		at = c + 1;
+		lo = c + 1;
+		*hi = b;
+	} else {
+		// the stops between b and c slide left in front of it
+		memcpy(trial + a, tour + b + 1, (c - b) * sizeof(int));
+		at = c - len + 1;
+		lo = a;
+		*hi = c;
+	}
+	for (int k = 0; k < len; k++) {
+		trial[at + k] = reversed ? tour[b - k] : tour[a + k];
+	}
+	return lo;
+}
+
+/* scores a candidate move from its walking delta (walk-only days) or by
+   rescheduling trial from lo, and makes it if the day gets shorter. Returns
+   true when the move was made */
+static bool tryMove(const struct Plan *plan, int *tour, const int *trial, const unsigned char *usePass, int *offTimes, int *trialTimes, struct Walks *walks, int *cost, bool walkOnly, int delta, int lo, int hi) {
+	int new_cost;
+
+	if (walkOnly) {
+		planMetrics.movesEvaluated++;
+		new_cost = *cost + delta;
+	} else {
+		new_cost = evaluateSuffix(plan, trial, usePass, offTimes, trialTimes, lo, hi + 1);
+	}
+	if (new_cost >= *cost) {
+		return false;
+	}
+
+	memcpy(tour + lo, trial + lo, (hi - lo + 1) * sizeof(int));
+	if (!walkOnly) {
+		rescheduleFrom(plan, tour, usePass, offTimes, lo);
+	}
+	sumWalks(plan, tour, walks);
+	*cost = new_cost;
+	planMetrics.movesAccepted++;
+	noteImprovement();
+	return true;
+}
+
+/* looks through one neighbourhood for an improving move and makes the first
+   one found. The scan goes round the tour starting at the position *cursor,
+   where the last improving move of this kind was found, since the moves
+   before it were just found not to improve. Returns true when a move was
+   made */
+static bool improveIn(const struct Plan *plan, int kind, int *tour, const unsigned char *usePass, int *offTimes, int *trialTimes, struct Walks *walks, int *cost, bool walkOnly, int *cursor) {
+	int n = plan->length;
+	int trial[MAX_ROWS];
+	int hi;
+
+	for (int k = 0; k < n - 2; k++) {
+		int a = 1 + (*cursor - 1 + k) % (n - 2);
+
+		if (kind == MOVE_RELOCATE || kind == MOVE_OR_OPT) {
+			int shortest = kind == MOVE_RELOCATE ? 1 : 2;
+			int longest = kind == MOVE_RELOCATE ? 1 : OR_OPT_LONGEST;
+			for (int b = a + shortest - 1; b <= a + longest - 1 && b <= n - 2; b++) {
+				for (int c = 0; c <= n - 2; c++) {
+					if (c >= a - 1 && c <= b) {
+						continue;
+					}
+					for (int r = 0; r < (b > a ? 2 : 1); r++) {
+						int delta = relocateDelta(plan, tour, walks, a, b, c, r);
+						if (walkOnly && delta >= 0) {
+							planMetrics.movesEvaluated++;
+							continue;
+						}
+						int lo = applyRelocate(tour, trial, n, a, b, c, r, &hi);
+						if (tryMove(plan, tour, trial, usePass, offTimes, trialTimes, walks, cost, walkOnly, delta, lo, hi)) {
+							*cursor = a;
+							return true;
+						}
+					}
+				}
+			}
+			continue;
+		}
+
+		for (int j = a + 1; j <= n - 2; j++) {
+			int delta = kind == MOVE_SWAP ? swapDelta(plan, tour, a, j) : twoOptDelta(plan, tour, walks, a, j);
+			if (walkOnly && delta >= 0) {
+				planMetrics.movesEvaluated++;
+				continue;
+			}
+
+			if (kind == MOVE_SWAP) {
+				memcpy(trial, tour, n * sizeof(int));
+				swap(&trial[a], &trial[j]);
+			} else {
+				flipTour(plan, tour, trial, a, j);
+			}
+			if (tryMove(plan, tour, trial, usePass, offTimes, trialTimes, walks, cost, walkOnly, delta, a, j)) {
+				*cursor = a;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/* variable neighbourhood descent over relocate, swap, or-opt and 2-opt moves
+   with the passes in usePass (may be NULL) kept as they are. tour ends at a
+   tour no single move of any of the four kinds improves, or at the first
+   within plan->stopCost. Returns its total time */
+int optimizeVnd(const struct Plan *plan, int *tour, const unsigned char *usePass) {
+	int offTimes[MAX_ROWS], trialTimes[MAX_ROWS];
+	struct Walks walks;
+	bool walkOnly = plan->flatWaits && usePass == NULL;
+
+	int cost = scheduleTour(plan, tour, usePass, offTimes);
+	if (plan->length < 4) {
+		return cost;
+	}
+	sumWalks(plan, tour, &walks);
+
+	int cursor[NUM_MOVES] = {1, 1, 1, 1};
+	int kind = 0;
+	while (kind < NUM_MOVES && keepSearching(plan, cost)) {
+		if (improveIn(plan, kind, tour, usePass, offTimes, trialTimes, &walks, &cost, walkOnly, &cursor[kind])) {
+			kind = 0;
+		} else {
+			kind++;
+		}
+	}
+	return cost;
+}